@@ -0,0 +1,104 @@
+// Native OBJ loader (rg/ObjLoader.h) against the ASSIMP import it replaces.
+// usage: ./obj_loader_benchmark [runs] [file.obj ...]   (default: the bundled models, 10 runs)
+// Both sides produce MeshData before any optimization or caching; the outputs are compared vertex by vertex.
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model.h>
+#include <rg/ObjLoader.h>
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+template<typename F>
+double median_milliseconds(unsigned int runs, F load) {
+    std::vector<double> times;
+    for (unsigned int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        load();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+float max_difference(const glm::vec3 &a, const glm::vec3 &b) {
+    glm::vec3 d = glm::abs(a - b);
+    return std::max(d.x, std::max(d.y, d.z));
+}
+
+// empty when the outputs match (up to float noise in the derived attributes)
+std::string compare(const std::vector<MeshData> &assimp, const std::vector<MeshData> &native) {
+    if (assimp.size() != native.size())
+        return "mesh count " + std::to_string(assimp.size()) + " vs " + std::to_string(native.size());
+    float position = 0.0f, normal = 0.0f, texCoords = 0.0f, tangent = 0.0f;
+    for (size_t m = 0; m < assimp.size(); m++) {
+        const MeshData &a = assimp[m], &b = native[m];
+        if (a.vertices.size() != b.vertices.size() || a.indices != b.indices)
+            return "mesh " + std::to_string(m) + " topology differs (" + std::to_string(a.vertices.size()) + " vs "
+                   + std::to_string(b.vertices.size()) + " vertices)";
+        for (size_t t = 0; t < a.textures.size() || t < b.textures.size(); t++)
+            if (t >= a.textures.size() || t >= b.textures.size() || a.textures[t].type != b.textures[t].type
+                || a.textures[t].path != b.textures[t].path)
+                return "mesh " + std::to_string(m) + " textures differ";
+        for (size_t v = 0; v < a.vertices.size(); v++) {
+            position = std::max(position, max_difference(a.vertices[v].Position, b.vertices[v].Position));
+            normal = std::max(normal, max_difference(a.vertices[v].Normal, b.vertices[v].Normal));
+            texCoords = std::max(texCoords, max_difference(glm::vec3(a.vertices[v].TexCoords, 0.0f),
+                                                           glm::vec3(b.vertices[v].TexCoords, 0.0f)));
+            tangent = std::max(tangent, std::max(max_difference(a.vertices[v].Tangent, b.vertices[v].Tangent),
+                                                 max_difference(a.vertices[v].Bitangent, b.vertices[v].Bitangent)));
+        }
+    }
+    if (position > 1e-5f || texCoords > 1e-5f || normal > 1e-3f || tangent > 1e-2f)
+        return "attributes differ: position " + std::to_string(position) + ", normal " + std::to_string(normal)
+               + ", uv " + std::to_string(texCoords) + ", tangent " + std::to_string(tangent);
+    return "";
+}
+
+int main(int argc, char **argv) {
+    unsigned int runs = 10;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        if (i == 1 && std::atoi(argv[i]) > 0)
+            runs = (unsigned int) std::atoi(argv[i]);
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.empty()) {
+        for (const char *model : {"amanita/amanita_a_low.obj", "ambrela/Big_ambrella_low.obj", "boletus/boletus_low.obj",
+                                  "chantarelle/chanterelles_low.obj", "morel/morel_low.obj", "russula/russula_low.obj",
+                                  "cat/12221_Cat_v1_l3.obj", "flamingo/19376_PinkFlamingo_V1.obj", "rabbit/Rabbit.obj"})
+            paths.push_back(FileSystem::getPath(std::string("resources/objects/") + model));
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "threads: " << ThreadPool::global().size() << ", runs: " << runs << std::endl;
+    bool allMatch = true;
+    for (const std::string &path : paths) {
+        ModelData assimp;
+        std::vector<MeshData> native;
+        if (!Model::importWithAssimp(path, assimp) || !rg::loadObj(path, native)) {
+            std::cout << path << ": skipped, could not load" << std::endl;
+            continue;
+        }
+        double assimpTime = median_milliseconds(runs, [&path] {
+            ModelData data;
+            Model::importWithAssimp(path, data);
+        });
+        double nativeTime = median_milliseconds(runs, [&path] {
+            std::vector<MeshData> meshes;
+            rg::loadObj(path, meshes);
+        });
+        std::string difference = compare(assimp.meshes, native);
+        allMatch = allMatch && difference.empty();
+        std::cout << path.substr(path.find_last_of('/') + 1) << ": ASSIMP " << assimpTime << " ms, native "
+                  << nativeTime << " ms (" << assimpTime / std::max(nativeTime, 1e-3) << "x), "
+                  << (difference.empty() ? "same output" : difference) << std::endl;
+    }
+    return allMatch ? 0 : 1;
+}
@@ -5,14 +5,14 @@
 #ifndef PROJECT_BASE_COMMON_H
 #define PROJECT_BASE_COMMON_H
 #include <string>
-#include <fstream>
-#include <sstream>
 
+#include <rg/AssetArchive.h>
+
+// packed in the asset archive or loose on disk
 std::string readFileContents(std::string path) {
-    std::ifstream in(path);
-    std::stringstream buffer;
-    buffer << in.rdbuf();
-    return buffer.str();
+    rg::AssetFile file;
+    file.open(path);
+    return file.str();
 }
 
 
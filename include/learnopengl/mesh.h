@@ -7,9 +7,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/TextureLoader.h>
+#include <rg/TextureRegistry.h>
+#include <rg/VertexPacking.h>
+#include <rg/GLObject.h>
+#include <rg/GLState.h>
+#include <rg/RenderQueue.h>
 
 #include <string>
 #include <vector>
+#include <algorithm>
 using namespace std;
 
 struct Vertex {
@@ -25,48 +32,158 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// how a Mesh lays its vertices out on the GPU
+enum class VertexFormat {
+    Float,  // Vertex as is, 56 bytes
+    Packed  // PackedVertex, 20 bytes; shaders need PACKED_VERTEX defined and positionScale/positionOffset set
+};
+
+// whether a Mesh keeps its vertices and indices in memory once they are on the GPU
+enum class GeometryResidency {
+    GpuOnly, // dropped after upload, only the counts, levels and bounds stay
+    Keep     // for code that reads the geometry back (picking, collision, baking)
+};
+
+// most detail levels a mesh gets (LOD 0 included)
+const unsigned int MAX_LODS = 4;
+
+// one detail level: a range of the mesh's index buffer; every level indexes the same vertices
+struct MeshLod {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error; // largest deviation from LOD 0 the simplifier allowed, relative to the mesh extent
+};
 
 
+// axis aligned bounds of the vertex positions
+void computeBounds(const vector<Vertex> &vertices, glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+{
+    boundsMin = boundsMax = vertices.empty() ? glm::vec3(0.0f) : vertices[0].Position;
+    for(unsigned int i = 1; i < vertices.size(); i++)
+    {
+        boundsMin = glm::min(boundsMin, vertices[i].Position);
+        boundsMax = glm::max(boundsMax, vertices[i].Position);
+    }
+}
+
 struct Texture {
-    unsigned int id;
+    TextureHandle handle; // GL id becomes valid once the asynchronous upload is done
     string type;
     string path;
 };
 
+// CPU side result of importing one mesh; produced on worker threads, turned into a Mesh on the GL thread
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<Texture>      textures; // references only (type and path), the handle is resolved by the owning Model
+    vector<MeshLod>      lods;     // empty: indices is a single level
+    // read from the mesh cache: vertices and indices stay empty and these point into the mapping kept alive by
+    // ModelData::cache, so the buffers are filled straight from it
+    const Vertex       *mappedVertices = nullptr;
+    const unsigned int *mappedIndices = nullptr;
+    unsigned int numMappedVertices = 0;
+    unsigned int numMappedIndices = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    void computeBounds()
+    {
+        ::computeBounds(vertices, boundsMin, boundsMax);
+    }
+};
+
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data; vertices and indices are empty after construction unless the residency is Keep
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    // detail levels, finest first; all of them live in indices (and the EBO) back to back
+    vector<MeshLod>      lods;
 
-    unsigned int VAO;
-    std::string glslIdentifierPrefix;
+    // axis aligned bounds of the vertex positions in model space
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    // sizes of the GPU buffers, valid whatever the residency
+    unsigned int numVertices = 0;
+    unsigned int numIndices = 0;
+
+    VertexFormat vertexFormat = VertexFormat::Float;
+    GeometryResidency residency = GeometryResidency::GpuOnly;
+    // GL_UNSIGNED_SHORT when every index fits in 16 bits, GL_UNSIGNED_INT otherwise; chosen by setupMesh
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    rg::GLVertexArray VAO;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+         GeometryResidency residency = GeometryResidency::GpuOnly)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        ::computeBounds(this->vertices, boundsMin, boundsMax);
+        lods.push_back(MeshLod{0, (unsigned int) this->indices.size(), 0.0f});
+        this->residency = residency;
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size());
+        SetShaderTextureNamePrefix("");
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // constructor for imported data (bounds already known), textures must already be resolved to handles
+    Mesh(MeshData &&data, VertexFormat format = VertexFormat::Float,
+         GeometryResidency residency = GeometryResidency::GpuOnly)
     {
-        // bind appropriate textures
+        bool mapped = data.mappedVertices != nullptr;
+        if (mapped && residency == GeometryResidency::Keep)
+        {
+            vertices.assign(data.mappedVertices, data.mappedVertices + data.numMappedVertices);
+            indices.assign(data.mappedIndices, data.mappedIndices + data.numMappedIndices);
+        }
+        else
+        {
+            vertices = std::move(data.vertices);
+            indices = std::move(data.indices);
+        }
+        const Vertex *vertexData = mapped ? data.mappedVertices : vertices.data();
+        const unsigned int *indexData = mapped ? data.mappedIndices : indices.data();
+        size_t vertexCount = mapped ? data.numMappedVertices : vertices.size();
+        size_t indexCount = mapped ? data.numMappedIndices : indices.size();
+        textures = std::move(data.textures);
+        lods = std::move(data.lods);
+        if (lods.empty())
+            lods.push_back(MeshLod{0, (unsigned int) indexCount, 0.0f});
+        boundsMin = data.boundsMin;
+        boundsMax = data.boundsMax;
+        vertexFormat = format;
+        this->residency = residency;
+
+        setupMesh(vertexData, vertexCount, indexData, indexCount);
+        SetShaderTextureNamePrefix("");
+    }
+
+    // owns its GL objects: moved, never copied
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+    Mesh(Mesh &&) = default;
+    Mesh &operator=(Mesh &&) = default;
+
+    // sampler uniforms are named prefix + type + N (N counting per type from 1); built here once, not every Draw
+    void SetShaderTextureNamePrefix(const string &prefix)
+    {
+        glslIdentifierPrefix = prefix;
+        samplerNames.clear();
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
-            string name = textures[i].type;
+            const string &name = textures[i].type;
             if(name == "texture_diffuse")
                 number = std::to_string(diffuseNr++);
             else if(name == "texture_specular")
@@ -75,46 +192,141 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
+            samplerNames.push_back(glslIdentifierPrefix + name + number);
+        }
+    }
 
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    // packed positions are stored relative to the mesh bounds; the shader maps them back with these
+    void SetVertexDecodeUniforms(Shader &shader) const
+    {
+        if (vertexFormat != VertexFormat::Packed)
+            return;
+        shader.setVec3("positionScale", boundsMax - boundsMin);
+        shader.setVec3("positionOffset", boundsMin);
+    }
+
+    // false once the CPU copy of the geometry was dropped
+    bool HasGeometry() const
+    {
+        return residency == GeometryResidency::Keep;
+    }
+
+    unsigned int LodCount() const
+    {
+        return lods.size();
+    }
+
+    // levels past the last one this mesh has draw its coarsest
+    const MeshLod &Lod(unsigned int lod) const
+    {
+        return lods[std::min(lod, (unsigned int) lods.size() - 1)];
+    }
+
+    // size of the vertex and index buffers
+    size_t GpuBytes() const
+    {
+        size_t vertexSize = vertexFormat == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        return numVertices * vertexSize + numIndices * indexSize;
+    }
+
+    // byte offset of a level in the EBO, for glDrawElements*
+    const void *LodIndexOffset(unsigned int lod) const
+    {
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        return (const void *) (Lod(lod).indexOffset * indexSize);
+    }
+
+    // render the mesh
+    void Draw(Shader &shader, unsigned int lod = 0)
+    {
+        // bind appropriate textures
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            // set the sampler to the texture unit
+            shader.setInt(samplerNames[i], i);
+            // and bind the texture to it, unless it's there already
+            rg::GLState::global().bindTexture(i, GL_TEXTURE_2D, textures[i].handle->id);
         }
 
 
 
         // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        SetVertexDecodeUniforms(shader);
+        // the bindings stay for the next draw, rg::GLState skips what it doesn't change
+        rg::GLState::global().bindVertexArray(VAO.id());
+        glDrawElements(GL_TRIANGLES, Lod(lod).indexCount, indexType, LodIndexOffset(lod));
+    }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    // queues the draw instead (see rg::RenderQueue); model is set as modelUniform and has to outlive the frame
+    void Submit(rg::RenderQueue &queue, Shader &shader, rg::RenderPass pass, float depth, const glm::mat4 *model,
+                Shader::Uniform modelUniform, unsigned int lod = 0) const
+    {
+        rg::RenderMaterial material;
+        for(unsigned int i = 0; i < textures.size(); i++)
+            material.add(GL_TEXTURE_2D, textures[i].handle->id);
+        material.samplerNames = samplerNames.data();
+        rg::DrawPacket packet = rg::DrawPacket::elements(shader, queue.material(material), VAO.id(),
+                                                         Lod(lod).indexCount, indexType, LodIndexOffset(lod));
+        packet.model = model;
+        packet.modelUniform = modelUniform;
+        if (vertexFormat == VertexFormat::Packed)
+        {
+            packet.prepare = [](Shader &shader, const void *mesh, const void *, unsigned int) {
+                ((const Mesh *) mesh)->SetVertexDecodeUniforms(shader);
+            };
+            packet.object = this;
+        }
+        queue.submit(pass, depth, packet);
     }
 
 private:
     // render data
-    unsigned int VBO, EBO;
+    rg::GLBuffer VBO, EBO;
+    std::string glslIdentifierPrefix;
+    vector<string> samplerNames; // per texture, see SetShaderTextureNamePrefix
+
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // initializes all the buffer objects/arrays from vertexData and indexData (the vectors or a mapped cache entry)
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
     {
+        numVertices = vertexCount;
+        numIndices = indexCount;
+
         // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        VAO = rg::GLVertexArray::create();
+        VBO = rg::GLBuffer::create();
+        EBO = rg::GLBuffer::create();
+
+        rg::GLState::global().bindVertexArray(VAO.id());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.id());
+        if (vertexCount <= 65536)
+        {
+            // half the index memory and fetch bandwidth
+            vector<unsigned short> shortIndices(indexData, indexData + indexCount);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+            indexType = GL_UNSIGNED_SHORT;
+        }
+        else
+        {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+            indexType = GL_UNSIGNED_INT;
+        }
+
+        if (vertexFormat == VertexFormat::Packed)
+        {
+            setupPackedVertices(vertexData, vertexCount);
+            rg::GLState::global().bindVertexArray(0);
+            releaseGeometry();
+            return;
+        }
 
-        glBindVertexArray(VAO);
         // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO.id());
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
         // vertex Positions
@@ -133,7 +345,45 @@ private:
         glEnableVertexAttribArray(4);
         glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
-        glBindVertexArray(0);
+        rg::GLState::global().bindVertexArray(0);
+        releaseGeometry();
+    }
+
+    // the GL buffers hold their own copy now; frees the CPU one unless it is to be kept
+    void releaseGeometry()
+    {
+        if (residency == GeometryResidency::Keep)
+            return;
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
+
+    // 20 byte PackedVertex instead of Vertex, decoded by the PACKED_VERTEX path of the vertex shaders
+    void setupPackedVertices(const Vertex *vertexData, size_t vertexCount)
+    {
+        vector<PackedVertex> packed(vertexCount);
+        glm::vec3 scale = boundsMax - boundsMin;
+        for(size_t i = 0; i < vertexCount; i++)
+        {
+            const Vertex &v = vertexData[i];
+            packed[i] = rg::packVertex(v.Position, v.Normal, v.TexCoords, v.Tangent, v.Bitangent, boundsMin, scale);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO.id());
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedVertex), packed.data(), GL_STATIC_DRAW);
+
+        // position (xyz) + tangent handedness (w)
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+        // octahedral normal
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+        // texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+        // octahedral tangent, no bitangent attribute
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Tangent));
     }
 };
 #endif
\ No newline at end of file
@@ -12,68 +12,205 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
+#include <rg/MeshCache.h>
+#include <rg/MeshOptimizer.h>
+#include <rg/ObjLoader.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+TextureHandle TextureFromFile(const char *path, const string &directory, bool gamma = false, bool normalMap = false);
 
 
 
+// CPU side result of importing a model file, see Model::import
+struct ModelData {
+    string directory;
+    vector<MeshData> meshes;
+    // the cache entry the meshes were read from (see MeshData::mappedVertices), null after an import
+    std::shared_ptr<MeshCache> cache;
+};
+
 class Model
 {
 public:
+    // post processing applied on import; part of the mesh cache key, so changing it rebakes every model
+    static const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
     // model data
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    // GPU layout of the meshes created by upload()
+    VertexFormat vertexFormat;
+    // whether the meshes keep their vertices and indices after upload (default: no, GPU copy only)
+    GeometryResidency residency = GeometryResidency::GpuOnly;
+    // union of the mesh bounds, model space
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    // empty model, filled in later by upload() (see WorldStreamer::loadModel)
+    Model() : gammaCorrection(false), vertexFormat(VertexFormat::Float)
+    {
+    }
+
+    // empty model whose meshes will use the given vertex layout and residency
+    explicit Model(VertexFormat format, GeometryResidency residency = GeometryResidency::GpuOnly)
+        : gammaCorrection(false), vertexFormat(format), residency(residency)
+    {
+    }
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false) : gammaCorrection(gamma), vertexFormat(VertexFormat::Float)
     {
-        loadModel(path);
+        upload(import(path));
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // the meshes own GL objects: pass models by reference, move them if they have to change hands
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+    Model(Model &&) = default;
+    Model &operator=(Model &&) = default;
+
+    // draws the model, and thus all its meshes, at the given level of detail
+    void Draw(Shader &shader, unsigned int lod = 0)
     {
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            meshes[i].Draw(shader, lod);
+    }
+
+    // queues the draws of all the meshes, see Mesh::Submit
+    void Submit(rg::RenderQueue &queue, Shader &shader, rg::RenderPass pass, float depth, const glm::mat4 *model,
+                Shader::Uniform modelUniform, unsigned int lod = 0) const
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Submit(queue, shader, pass, depth, model, modelUniform, lod);
+    }
+
+    // detail levels of the most detailed mesh; meshes with fewer draw their coarsest one past their last
+    unsigned int LodCount() const
+    {
+        unsigned int count = 1;
+        for (const Mesh &mesh : meshes)
+            count = std::max(count, mesh.LodCount());
+        return count;
+    }
+
+    // GPU memory of the meshes plus that of the textures uploaded so far (textures shared with other models included)
+    size_t GpuBytes() const
+    {
+        size_t bytes = 0;
+        for (const Mesh &mesh : meshes)
+            bytes += mesh.GpuBytes();
+        for (const Texture &texture : textures_loaded)
+            bytes += texture.handle ? texture.handle->gpuBytes : 0;
+        return bytes;
     }
 
     void SetShaderTextureNamePrefix(std::string prefix) {
+        shaderTextureNamePrefix = prefix;
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.SetShaderTextureNamePrefix(prefix);
         }
     }
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+
+    // CPU half of loading a model: maps the mesh cache entry or imports the file (and bakes it).
+    // touches no OpenGL state, so it can run on any thread.
+    static ModelData import(string const &path)
+    {
+        ModelData data;
+        // retrieve the directory path of the filepath
+        data.directory = path.substr(0, path.find_last_of('/'));
+
+        if (loadFromCache(path, data))
+            return data;
+
+        // .obj files go through the native loader, everything else through ASSIMP
+        bool loaded = rg::isObjFile(path) ? rg::loadObj(path, data.meshes) : importWithAssimp(path, data);
+        if (!loaded)
+            return data;
+
+        // weld, build the detail levels, then reorder for the vertex cache, overdraw and vertex fetch
+        for(unsigned int i = 0; i < data.meshes.size(); i++)
+            rg::optimizeMesh(data.meshes[i], path + " mesh " + std::to_string(i));
+
+        MeshCache::write(path, importFlags, data.meshes);
+        return data;
+    }
+
+    // reads path with ASSIMP into data.meshes, as imported (no optimization, no cache); false on failure.
+    // .obj files don't take this path, it stays available to compare the native loader against
+    static bool importWithAssimp(string const &path, ModelData &data)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, importFlags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, data);
+        return true;
+    }
+
+    // GL half of loading a model: loads the referenced textures and creates the buffers. context thread only.
+    void upload(ModelData &&data)
+    {
+        directory = data.directory;
+        meshes.reserve(meshes.size() + data.meshes.size());
+        for (MeshData &meshData : data.meshes)
+        {
+            for (Texture &texture : meshData.textures)
+                texture = loadTexture(texture.path, texture.type);
+            meshes.emplace_back(std::move(meshData), vertexFormat, residency);
+            meshes.back().SetShaderTextureNamePrefix(shaderTextureNamePrefix);
+        }
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            boundsMin = i == 0 ? meshes[i].boundsMin : glm::min(boundsMin, meshes[i].boundsMin);
+            boundsMax = i == 0 ? meshes[i].boundsMax : glm::max(boundsMax, meshes[i].boundsMax);
+        }
+    }
+private:
+    std::string shaderTextureNamePrefix;
+
+    // maps the cache entry, the meshes point into it until upload() fills their buffers; false if there is no valid one
+    static bool loadFromCache(string const &path, ModelData &data)
+    {
+        std::shared_ptr<MeshCache> cache = std::make_shared<MeshCache>();
+        if (!cache->open(path, importFlags))
+            return false;
+
+        for (const MeshCache::MeshView &view : cache->meshes())
+        {
+            MeshData mesh;
+            mesh.mappedVertices = view.vertices;
+            mesh.mappedIndices = view.indices;
+            mesh.numMappedVertices = view.numVertices;
+            mesh.numMappedIndices = view.numIndices;
+            mesh.textures = view.textures;
+            mesh.lods = view.lods;
+            mesh.boundsMin = view.boundsMin;
+            mesh.boundsMax = view.boundsMax;
+            data.meshes.push_back(std::move(mesh));
+        }
+        data.cache = std::move(cache);
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, ModelData &data)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -81,22 +218,23 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            data.meshes.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, data);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<Texture> &textures = data.textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -178,13 +316,14 @@ private:
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, the GL objects are created by upload()
+        data.computeBounds();
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // collects all material textures of a given type. only the type and path of the returned
+    // Texture structs are filled in, upload() loads them.
+    static vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
 //        std::cout << "objekat " << typeName <<  " ima " << mat->GetTextureCount((type)) <<" teksturea\n";
@@ -192,69 +331,48 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            Texture texture;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
         return textures;
     }
+
+    // looks the texture at path (relative to the model directory) up in the process wide TextureRegistry,
+    // which loads it only if no one did so yet. textures_loaded keeps this model's distinct textures in load order.
+    Texture loadTexture(const string &path, const string &typeName)
+    {
+        Texture texture;
+        texture.handle = TextureFromFile(path.c_str(), this->directory, typeName == "texture_diffuse", typeName == "texture_normal");
+        texture.type = typeName;
+        texture.path = path;
+        for(unsigned int j = 0; j < textures_loaded.size(); j++)
+        {
+            if(textures_loaded[j].handle == texture.handle)
+                return textures_loaded[j]; // a texture with the same filepath has already been loaded (optimization)
+        }
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model
+        return texture;
+    }
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+// shared texture from the TextureRegistry; a new image starts decoding on the worker threads and the
+// returned handle becomes resident once TextureLoader::update() uploaded it. model textures are kept
+// block compressed, normal maps as BC5; gamma marks sRGB color whose mips are filtered in linear space
+TextureHandle TextureFromFile(const char *path, const string &directory, bool gamma, bool normalMap)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    TextureParams params;
+    params.wrap = GL_REPEAT;
+    params.minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    params.magFilter = GL_LINEAR;
+    params.compress = true;
+    params.normalMap = normalMap;
+    params.srgb = gamma;
+    return TextureRegistry::global().acquire(filename, params);
 }
 #endif
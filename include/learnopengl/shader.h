@@ -8,176 +8,354 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <algorithm>
 #include <common.h>
+#include <rg/ProgramCache.h>
+#include <rg/AssetArchive.h>
+#include <rg/FrameUniforms.h>
+#include <rg/GLState.h>
 class Shader
 {
 public:
     unsigned int ID;
+
+    // an active uniform of the program resolved once (see uniform()), setting it through the handle is an index
+    // into the uniform table. Names the program doesn't have give a handle the setters ignore
+    struct Uniform {
+        int slot = -1;
+    };
+
     // constructor generates the shader on the fly
+    // defines are added as "#define NAME" right after the #version line of every stage
+    // the linked program is cached (see ProgramCache), so unchanged sources are compiled once per driver.
+    // returns once compile and link are submitted; use() (or ready()/finish()) checks the result
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr,
+           const std::vector<std::string> &defines = std::vector<std::string>())
     {
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
+        std::string geometryPathString(geometryPath ? geometryPath : "");
 
-        vertexPath = vertexPathString.c_str();
-        fragmentPath= fragmentPathString.c_str();
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
-        {
+        // 1. retrieve the vertex/fragment source code from filePath (a view into the asset archive when packed)
+        rg::AssetFile vShaderFile, fShaderFile, gShaderFile;
+        if (!vShaderFile.open(vertexPathString) || !fShaderFile.open(fragmentPathString)
+            || (geometryPath != nullptr && !gShaderFile.open(geometryPathString)))
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        // copied once, with the defines put in
+        std::string vertexCode = addDefines(vShaderFile, defines);
+        std::string fragmentCode = addDefines(fShaderFile, defines);
+        std::string geometryCode = addDefines(gShaderFile, defines);
+
+        // reuse the binary of the last build of the same sources
+        std::string identity = fragmentPathString + "|" + geometryPathString;
+        for (const std::string &define : defines)
+            identity += "|" + define;
+        // the vertex stage last, the cache entry is named after its file
+        identity += "|" + vertexPathString;
+        std::shared_ptr<PendingProgram> pending = std::make_shared<PendingProgram>();
+        pending->cache = ProgramCache(identity, vertexCode + '\0' + fragmentCode + '\0' + geometryCode);
+        ID = glCreateProgram();
+        if (pending->cache.load(ID))
+        {
+            rg::bindUniformBlocks(ID);
+            reflectUniforms();
+            return;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        // a rejected binary can leave the program in any state, start over with a fresh one
+        glDeleteProgram(ID);
+
+        // 2. submit the stages and the link without waiting on any of them; the driver may compile in the
+        // background, errors are checked by ready() or the first use()
+        pending->stages.push_back(PendingProgram::Stage{compileStage(GL_VERTEX_SHADER, vertexCode), "VERTEX"});
+        pending->stages.push_back(PendingProgram::Stage{compileStage(GL_FRAGMENT_SHADER, fragmentCode), "FRAGMENT"});
         // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
         if(geometryPath != nullptr)
-        {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
+            pending->stages.push_back(PendingProgram::Stage{compileStage(GL_GEOMETRY_SHADER, geometryCode), "GEOMETRY"});
         // shader Program
         ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
+        pending->cache.prepare(ID);
+        for (const PendingProgram::Stage &stage : pending->stages)
+            glAttachShader(ID, stage.shader);
         glLinkProgram(ID);
+        m_Pending = pending;
+    }
+    // the uniform table keeps the values last set on the program, a copy would go stale
+    Shader(const Shader &) = delete;
+    Shader &operator=(const Shader &) = delete;
+
+    // true once the program is linked and checked. Doesn't block when the driver reports completion
+    // (GL_KHR_parallel_shader_compile); without it the first call waits for the driver
+    bool ready()
+    {
+        if (!m_Pending || m_Pending->checked)
+            return true;
+        if (rg::glExtensions().MaxShaderCompilerThreads)
+        {
+            GLint complete = GL_FALSE;
+            glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &complete);
+            if (!complete)
+                return false;
+        }
+        finish();
+        return true;
+    }
+
+    // waits for the program, reports compile and link errors and caches the binary
+    void finish()
+    {
+        if (!m_Pending || m_Pending->checked)
+            return;
+        for (const PendingProgram::Stage &stage : m_Pending->stages)
+            checkCompileErrors(stage.shader, stage.type);
         checkCompileErrors(ID, "PROGRAM");
+        m_Pending->cache.store(ID);
+        rg::bindUniformBlocks(ID);
+        reflectUniforms();
         // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        for (const PendingProgram::Stage &stage : m_Pending->stages)
+            glDeleteShader(stage.shader);
+        m_Pending->checked = true;
+        m_Pending.reset();
     }
+
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        finish();
+        rg::GLState::global().useProgram(ID);
     }
+    // the handle of a uniform by its GLSL name ("material.shininess", "lights[2]"; an array by its bare name is its first
+    // element). Waits for the program like use()
+    Uniform uniform(const char *name)
+    {
+        finish();
+        auto found = std::lower_bound(m_UniformNames.begin(), m_UniformNames.end(), name,
+                                      [](const std::pair<std::string, int> &entry, const char *key) {
+                                          return std::strcmp(entry.first.c_str(), key) < 0;
+                                      });
+        Uniform uniform;
+        if (found != m_UniformNames.end() && found->first == name)
+            uniform.slot = found->second;
+        return uniform;
+    }
+    Uniform uniform(const std::string &name)
+    {
+        return uniform(name.c_str());
+    }
+
     // utility uniform functions
+    // they make this program current to upload, so they may be called while another one is in use; a value equal to
+    // the one the program already has isn't uploaded
+    // ------------------------------------------------------------------------
+    void setBool(Uniform uniform, bool value)
+    {
+        setInt(uniform, (int)value);
+    }
+    void setInt(Uniform uniform, int value)
+    {
+        store(uniform, value, [&](GLint location) { glUniform1i(location, value); });
+    }
+    void setFloat(Uniform uniform, float value)
+    {
+        store(uniform, value, [&](GLint location) { glUniform1f(location, value); });
+    }
+    void setVec2(Uniform uniform, const glm::vec2 &value)
+    {
+        store(uniform, value, [&](GLint location) { glUniform2fv(location, 1, &value[0]); });
+    }
+    void setVec3(Uniform uniform, const glm::vec3 &value)
+    {
+        store(uniform, value, [&](GLint location) { glUniform3fv(location, 1, &value[0]); });
+    }
+    void setVec4(Uniform uniform, const glm::vec4 &value)
+    {
+        store(uniform, value, [&](GLint location) { glUniform4fv(location, 1, &value[0]); });
+    }
+    void setMat2(Uniform uniform, const glm::mat2 &mat)
+    {
+        store(uniform, mat, [&](GLint location) { glUniformMatrix2fv(location, 1, GL_FALSE, &mat[0][0]); });
+    }
+    void setMat3(Uniform uniform, const glm::mat3 &mat)
+    {
+        store(uniform, mat, [&](GLint location) { glUniformMatrix3fv(location, 1, GL_FALSE, &mat[0][0]); });
+    }
+    void setMat4(Uniform uniform, const glm::mat4 &mat)
+    {
+        store(uniform, mat, [&](GLint location) { glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]); });
+    }
+
+    // by name, one lookup in the uniform table per call
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(const std::string &name, bool value)
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        setBool(uniform(name), value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const std::string &name, int value)
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        setInt(uniform(name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const std::string &name, float value)
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        setFloat(uniform(name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(const std::string &name, const glm::vec2 &value)
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec2(uniform(name), value);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(const std::string &name, float x, float y)
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        setVec2(uniform(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(const std::string &name, const glm::vec3 &value)
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec3(uniform(name), value);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(const std::string &name, float x, float y, float z)
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        setVec3(uniform(name), glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(const std::string &name, const glm::vec4 &value)
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec4(uniform(name), value);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        setVec4(uniform(name), glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const std::string &name, const glm::mat2 &mat)
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(uniform(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const std::string &name, const glm::mat3 &mat)
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(uniform(name), mat);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const std::string &name, const glm::mat4 &mat)
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(uniform(name), mat);
     }
     void setUniform1i(std::string name, int value) {
-        int uniformId = glGetUniformLocation(ID, name.c_str());
-        glUniform1i(uniformId, value);
+        setInt(uniform(name), value);
     }
 
     void setUniform1f(std::string name, double value) {
-        int uniformId = glGetUniformLocation(ID, name.c_str());
-        glUniform1f(uniformId, value);
+        setFloat(uniform(name), (float) value);
     }
 
 private:
+    // compile and link submitted but not checked yet
+    struct PendingProgram {
+        struct Stage {
+            GLuint shader;
+            const char *type;
+        };
+        std::vector<Stage> stages;
+        ProgramCache cache;
+        bool checked = false;
+    };
+    std::shared_ptr<PendingProgram> m_Pending;
+
+    // one active uniform (an element of an array) and the value the program has for it
+    struct UniformSlot {
+        GLint location;
+        bool known; // false until set through this shader, the program's own value isn't read back
+        unsigned char value[sizeof(glm::mat4)];
+    };
+    // built once the program is linked; m_UniformNames is sorted by name for uniform()
+    std::vector<UniformSlot> m_Uniforms;
+    std::vector<std::pair<std::string, int>> m_UniformNames;
+
+    void reflectUniforms()
+    {
+        m_Uniforms.clear();
+        m_UniformNames.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(ID, i, (GLsizei) buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            // arrays are reported as their first element
+            bool array = name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0;
+            if (array)
+                name.resize(name.size() - 3);
+            for (GLint element = 0; element < size; element++)
+            {
+                std::string elementName = array ? name + "[" + std::to_string(element) + "]" : name;
+                // members of uniform blocks have no location
+                GLint location = glGetUniformLocation(ID, elementName.c_str());
+                if (location < 0)
+                    continue;
+                UniformSlot slot;
+                slot.location = location;
+                slot.known = false;
+                m_UniformNames.emplace_back(elementName, (int) m_Uniforms.size());
+                if (array && element == 0)
+                    m_UniformNames.emplace_back(name, (int) m_Uniforms.size());
+                m_Uniforms.push_back(slot);
+            }
+        }
+        std::sort(m_UniformNames.begin(), m_UniformNames.end());
+    }
+
+    // uploads value with upload(location), with this program current, unless the program already has it
+    template<typename T, typename Upload>
+    void store(Uniform uniform, const T &value, Upload upload)
+    {
+        static_assert(sizeof(T) <= sizeof(UniformSlot::value), "uniform larger than its shadow copy");
+        if (uniform.slot < 0 || uniform.slot >= (int) m_Uniforms.size())
+            return;
+        UniformSlot &slot = m_Uniforms[uniform.slot];
+        if (slot.known && std::memcmp(slot.value, &value, sizeof(T)) == 0)
+            return;
+        std::memcpy(slot.value, &value, sizeof(T));
+        slot.known = true;
+        rg::GLState::global().useProgram(ID);
+        upload(slot.location);
+    }
+
+    static GLuint compileStage(GLenum type, const std::string &code)
+    {
+        const char *source = code.c_str();
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    static std::string addDefines(const rg::AssetFile &file, const std::vector<std::string> &defines)
+    {
+        std::string code = file.str();
+        if (defines.empty() || code.empty())
+            return code;
+        std::string lines;
+        for (const std::string &define : defines)
+            lines += "#define " + define + "\n";
+        // #version has to stay the first line
+        size_t afterVersion = code.compare(0, 8, "#version") == 0 ? code.find('\n') : std::string::npos;
+        if (afterVersion == std::string::npos)
+            return code.compare(0, 8, "#version") == 0 ? code + "\n" + lines : lines + code;
+        return code.substr(0, afterVersion + 1) + lines + code.substr(afterVersion + 1);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
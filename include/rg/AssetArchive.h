@@ -0,0 +1,212 @@
+#ifndef PROJECT_BASE_ASSETARCHIVE_H
+#define PROJECT_BASE_ASSETARCHIVE_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <sys/mman.h>
+
+#include <learnopengl/filesystem.h>
+#include <rg/DiskCache.h>
+
+// All of resources/ packed into one file (resources.pack, made by tools/pack_assets.cpp) that is mapped once at
+// start; the loaders get views into the mapping instead of opening, reading and copying every file on its own.
+// Layout:
+//   header   magic, format version, entry count, 0
+//   index    per entry {path offset, path length, data offset, size, mtime}, sorted by path (bytewise)
+//   paths    the entry paths, relative to the project root ("resources/shaders/plato.vs")
+//   data     the file contents, each starting on an ENTRY_ALIGNMENT boundary
+// Paths missing from the archive (or every path, when there is no archive) are read from disk.
+namespace rg {
+
+    class AssetArchive {
+    public:
+        static const uint32_t MAGIC = 0x4b504752; // "RGPK"
+        static const uint32_t VERSION = 1;
+        static const size_t ENTRY_ALIGNMENT = 64;
+
+        struct Entry {
+            uint32_t pathOffset;
+            uint32_t pathLength;
+            uint64_t dataOffset;
+            uint64_t size;
+            int64_t mtime; // of the file that was packed, stands in for it in cache signatures
+        };
+
+        // the archive the loaders read from; mount it before starting any loads
+        static AssetArchive &global() {
+            static AssetArchive archive;
+            return archive;
+        }
+
+        // maps the archive and asks the kernel to read all of it ahead; false (and no archive) on failure
+        bool open(const std::string &path) {
+            m_File.close();
+            m_Entries = nullptr;
+            m_NumEntries = 0;
+            if (!m_File.open(path))
+                return false;
+            madvise((void *) m_File.data(), m_File.size(), MADV_WILLNEED);
+            rg::BinaryReader in(m_File.data(), m_File.size());
+            uint32_t magic = in.get<uint32_t>(), version = in.get<uint32_t>(), count = in.get<uint32_t>();
+            in.get<uint32_t>();
+            const Entry *entries = (const Entry *) in.getBytes((size_t) count * sizeof(Entry));
+            if (!in.ok() || magic != MAGIC || version != VERSION)
+                return reject(path, "format");
+            for (uint32_t i = 0; i < count; i++)
+                if ((uint64_t) entries[i].pathOffset + entries[i].pathLength > m_File.size()
+                    || entries[i].dataOffset > m_File.size() || entries[i].size > m_File.size() - entries[i].dataOffset)
+                    return reject(path, "corrupt");
+            m_Entries = entries;
+            m_NumEntries = count;
+            return true;
+        }
+
+        bool isOpen() const { return m_Entries != nullptr; }
+
+        // the packed entry of path (absolute or relative to the project root), nullptr if it isn't packed
+        const Entry *find(const std::string &path) const {
+            if (!m_Entries)
+                return nullptr;
+            std::string key = relativePath(path);
+            const Entry *end = m_Entries + m_NumEntries;
+            const Entry *entry = std::lower_bound(m_Entries, end, key, [this](const Entry &e, const std::string &k) {
+                return compare(e, k) < 0;
+            });
+            return entry != end && compare(*entry, key) == 0 ? entry : nullptr;
+        }
+
+        const unsigned char *data(const Entry &entry) const { return m_File.data() + entry.dataOffset; }
+
+        // path as stored in the archive: relative to the project root, no "./"
+        static std::string relativePath(const std::string &path) {
+            std::string root = FileSystem::getPath("");
+            std::string relative = !root.empty() && root != "/" && path.compare(0, root.size(), root) == 0
+                                   ? path.substr(root.size()) : path;
+            while (relative.compare(0, 2, "./") == 0)
+                relative = relative.substr(2);
+            return relative;
+        }
+
+        // packs files (paths relative to root) into archivePath
+        static bool write(const std::string &archivePath, const std::string &root, std::vector<std::string> files) {
+            std::sort(files.begin(), files.end());
+            files.erase(std::unique(files.begin(), files.end()), files.end());
+            std::vector<Entry> entries(files.size());
+            std::string paths;
+            for (size_t i = 0; i < files.size(); i++) {
+                entries[i].pathOffset = (uint32_t) paths.size();
+                entries[i].pathLength = (uint32_t) files[i].size();
+                paths += files[i];
+            }
+            uint64_t pathsOffset = 16 + entries.size() * sizeof(Entry);
+            uint64_t offset = align(pathsOffset + paths.size());
+            for (size_t i = 0; i < files.size(); i++) {
+                rg::FileSignature signature = rg::fileSignature(root + "/" + files[i]);
+                if (!signature.exists) {
+                    std::cout << "ERROR::ASSET_ARCHIVE:: could not read " << files[i] << std::endl;
+                    return false;
+                }
+                entries[i].pathOffset += (uint32_t) pathsOffset;
+                entries[i].dataOffset = offset;
+                entries[i].size = signature.size;
+                entries[i].mtime = signature.mtime;
+                offset = align(offset + signature.size);
+            }
+
+            std::string out;
+            out.reserve(offset);
+            uint32_t header[4] = {MAGIC, VERSION, (uint32_t) entries.size(), 0};
+            out.append((const char *) header, sizeof(header));
+            out.append((const char *) entries.data(), entries.size() * sizeof(Entry));
+            out += paths;
+            for (size_t i = 0; i < files.size(); i++) {
+                out.resize(entries[i].dataOffset, '\0');
+                rg::MappedFile file;
+                if (entries[i].size > 0 && (!file.open(root + "/" + files[i]) || file.size() != entries[i].size)) {
+                    std::cout << "ERROR::ASSET_ARCHIVE:: " << files[i] << " changed while packing" << std::endl;
+                    return false;
+                }
+                out.append((const char *) file.data(), file.size());
+            }
+            return rg::writeFileAtomically(archivePath, out.data(), out.size());
+        }
+
+    private:
+        rg::MappedFile m_File;
+        const Entry *m_Entries = nullptr;
+        uint32_t m_NumEntries = 0;
+
+        static uint64_t align(uint64_t offset) {
+            return (offset + ENTRY_ALIGNMENT - 1) / ENTRY_ALIGNMENT * ENTRY_ALIGNMENT;
+        }
+
+        int compare(const Entry &entry, const std::string &key) const {
+            size_t length = std::min<size_t>(entry.pathLength, key.size());
+            int order = memcmp(m_File.data() + entry.pathOffset, key.data(), length);
+            if (order != 0)
+                return order;
+            return entry.pathLength < key.size() ? -1 : entry.pathLength > key.size() ? 1 : 0;
+        }
+
+        bool reject(const std::string &path, const char *reason) {
+            std::cout << "ERROR::ASSET_ARCHIVE:: ignoring " << path << " (" << reason << ")" << std::endl;
+            m_File.close();
+            return false;
+        }
+    };
+
+    // Contents of one asset: a view into the archive when it's packed, otherwise a mapping of the loose file.
+    // Either way nothing is copied; same interface as MappedFile.
+    class AssetFile {
+        rg::MappedFile m_File;
+        const unsigned char *m_Data = nullptr;
+        size_t m_Size = 0;
+        bool m_Open = false;
+    public:
+        bool open(const std::string &path, const AssetArchive &archive = AssetArchive::global()) {
+            close();
+            if (const AssetArchive::Entry *entry = archive.find(path)) {
+                m_Data = archive.data(*entry);
+                m_Size = (size_t) entry->size;
+                m_Open = true;
+            } else if (m_File.open(path)) {
+                m_Data = m_File.data();
+                m_Size = m_File.size();
+                m_Open = true;
+            }
+            return m_Open;
+        }
+
+        void close() {
+            m_File.close();
+            m_Data = nullptr;
+            m_Size = 0;
+            m_Open = false;
+        }
+
+        const unsigned char *data() const { return m_Data; }
+        size_t size() const { return m_Size; }
+        bool isOpen() const { return m_Open; }
+        std::string str() const { return m_Size ? std::string((const char *) m_Data, m_Size) : std::string(); }
+    };
+
+    // signature caches record for their sources: the packed file's when path is packed, the loose file's otherwise
+    FileSignature assetSignature(const std::string &path) {
+        if (const AssetArchive::Entry *entry = AssetArchive::global().find(path)) {
+            FileSignature signature;
+            signature.exists = true;
+            signature.size = entry->size;
+            signature.mtime = entry->mtime;
+            return signature;
+        }
+        return fileSignature(path);
+    }
+
+};
+
+#endif //PROJECT_BASE_ASSETARCHIVE_H
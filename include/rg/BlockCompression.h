@@ -0,0 +1,248 @@
+#ifndef PROJECT_BASE_BLOCKCOMPRESSION_H
+#define PROJECT_BASE_BLOCKCOMPRESSION_H
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+// CPU encoders for the BCn block formats the GL can sample directly:
+//   BC1 (DXT1)  RGB,        8 bytes per 4x4 block
+//   BC3 (DXT5)  RGBA,      16 bytes per block (BC4 alpha + BC1 color)
+//   BC4 (RGTC1) one channel, 8 bytes per block
+//   BC5 (RGTC2) two channels, 16 bytes per block, used for normal maps (xy, z is rebuilt in the shader)
+// Input is always tightly packed RGBA8; edge blocks of images that aren't a multiple of 4 repeat the last row/column.
+// Color endpoints come from the principal axis of each block, refined once by least squares; alpha and normal
+// channels use their min/max. Fast, and good enough for color and normal maps.
+namespace rg {
+
+    enum class BlockFormat {
+        BC1, BC3, BC4, BC5
+    };
+
+    size_t blockBytes(BlockFormat format) {
+        return (format == BlockFormat::BC1 || format == BlockFormat::BC4) ? 8 : 16;
+    }
+
+    size_t compressedSize(BlockFormat format, int width, int height) {
+        return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+    }
+
+    namespace detail {
+
+        uint16_t packRGB565(float r, float g, float b) {
+            int r5 = std::min(31, std::max(0, (int) std::lround(r * 31.0f / 255.0f)));
+            int g6 = std::min(63, std::max(0, (int) std::lround(g * 63.0f / 255.0f)));
+            int b5 = std::min(31, std::max(0, (int) std::lround(b * 31.0f / 255.0f)));
+            return (uint16_t) ((r5 << 11) | (g6 << 5) | b5);
+        }
+
+        void unpackRGB565(uint16_t color, int rgb[3]) {
+            int r5 = (color >> 11) & 31, g6 = (color >> 5) & 63, b5 = color & 31;
+            rgb[0] = (r5 << 3) | (r5 >> 2);
+            rgb[1] = (g6 << 2) | (g6 >> 4);
+            rgb[2] = (b5 << 3) | (b5 >> 2);
+        }
+
+        void writeLE(unsigned char *out, uint64_t value, int bytes) {
+            for (int i = 0; i < bytes; i++)
+                out[i] = (unsigned char) (value >> (8 * i));
+        }
+
+        // picks the nearest of the four palette colors for every texel, returns the squared error of the block
+        int chooseColorIndices(const unsigned char block[16][4], uint16_t color0, uint16_t color1, uint32_t &indices) {
+            int palette[4][3];
+            unpackRGB565(color0, palette[0]);
+            unpackRGB565(color1, palette[1]);
+            for (int c = 0; c < 3; c++) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            int total = 0;
+            indices = 0;
+            for (int i = 0; i < 16; i++) {
+                int best = 0, bestError = INT32_MAX;
+                for (int p = 0; p < 4; p++) {
+                    int dr = block[i][0] - palette[p][0], dg = block[i][1] - palette[p][1], db = block[i][2] - palette[p][2];
+                    int error = dr * dr + dg * dg + db * db;
+                    if (error < bestError) {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t) best << (2 * i);
+                total += bestError;
+            }
+            return total;
+        }
+
+        // endpoints as 565 with color0 > color1 (4 color mode); equal endpoints mean a flat block
+        void quantizeEndpoints(const float e0[3], const float e1[3], uint16_t &color0, uint16_t &color1) {
+            color0 = packRGB565(std::min(255.0f, std::max(0.0f, e0[0])), std::min(255.0f, std::max(0.0f, e0[1])),
+                                std::min(255.0f, std::max(0.0f, e0[2])));
+            color1 = packRGB565(std::min(255.0f, std::max(0.0f, e1[0])), std::min(255.0f, std::max(0.0f, e1[1])),
+                                std::min(255.0f, std::max(0.0f, e1[2])));
+            if (color0 < color1)
+                std::swap(color0, color1);
+        }
+
+        // 4x4 color block in 4 color mode (color0 > color1), as BC1 and the color half of BC3 need it
+        void encodeColorBlock(const unsigned char block[16][4], unsigned char *out) {
+            float mean[3] = {0, 0, 0};
+            for (int i = 0; i < 16; i++)
+                for (int c = 0; c < 3; c++)
+                    mean[c] += block[i][c] / 16.0f;
+
+            float cov[6] = {0, 0, 0, 0, 0, 0}; // rr rg rb gg gb bb
+            for (int i = 0; i < 16; i++) {
+                float d[3] = {block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2]};
+                cov[0] += d[0] * d[0];
+                cov[1] += d[0] * d[1];
+                cov[2] += d[0] * d[2];
+                cov[3] += d[1] * d[1];
+                cov[4] += d[1] * d[2];
+                cov[5] += d[2] * d[2];
+            }
+
+            // principal axis by power iteration
+            float axis[3] = {1.0f, 1.0f, 1.0f};
+            for (int iteration = 0; iteration < 8; iteration++) {
+                float next[3] = {
+                        cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                        cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                        cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]};
+                float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+                if (length < 1e-6f)
+                    break;
+                for (int c = 0; c < 3; c++)
+                    axis[c] = next[c] / length;
+            }
+
+            float minT = 0.0f, maxT = 0.0f;
+            for (int i = 0; i < 16; i++) {
+                float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+                minT = std::min(minT, t);
+                maxT = std::max(maxT, t);
+            }
+            // pull the endpoints in a little, the extremes are usually outliers
+            float inset = (maxT - minT) / 16.0f;
+            minT += inset;
+            maxT -= inset;
+
+            float e0[3], e1[3];
+            for (int c = 0; c < 3; c++) {
+                e0[c] = mean[c] + axis[c] * maxT;
+                e1[c] = mean[c] + axis[c] * minT;
+            }
+            uint16_t color0, color1;
+            quantizeEndpoints(e0, e1, color0, color1);
+            uint32_t indices = 0;
+            int error = color0 != color1 ? chooseColorIndices(block, color0, color1, indices) : INT32_MAX;
+
+            // refine once: least squares endpoints for the chosen indices, kept if they reduce the error
+            if (color0 != color1) {
+                static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+                float aa = 0, ab = 0, bb = 0, ax[3] = {0, 0, 0}, bx[3] = {0, 0, 0};
+                for (int i = 0; i < 16; i++) {
+                    float a = weights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+                    aa += a * a;
+                    ab += a * b;
+                    bb += b * b;
+                    for (int c = 0; c < 3; c++) {
+                        ax[c] += a * block[i][c];
+                        bx[c] += b * block[i][c];
+                    }
+                }
+                float determinant = aa * bb - ab * ab;
+                if (std::fabs(determinant) > 1e-6f) {
+                    for (int c = 0; c < 3; c++) {
+                        e0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+                        e1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+                    }
+                    uint16_t refined0, refined1;
+                    quantizeEndpoints(e0, e1, refined0, refined1);
+                    uint32_t refinedIndices;
+                    if (refined0 != refined1 && chooseColorIndices(block, refined0, refined1, refinedIndices) < error) {
+                        color0 = refined0;
+                        color1 = refined1;
+                        indices = refinedIndices;
+                    }
+                }
+            } else {
+                indices = 0;
+            }
+            writeLE(out, color0, 2);
+            writeLE(out + 2, color1, 2);
+            writeLE(out + 4, indices, 4);
+        }
+
+        // 4x4 block of one channel in 8 value mode (value0 > value1)
+        void encodeChannelBlock(const unsigned char block[16][4], int channel, unsigned char *out) {
+            int low = 255, high = 0;
+            for (int i = 0; i < 16; i++) {
+                low = std::min(low, (int) block[i][channel]);
+                high = std::max(high, (int) block[i][channel]);
+            }
+            uint64_t indices = 0;
+            if (high != low) {
+                int palette[8] = {high, low};
+                for (int p = 1; p < 7; p++)
+                    palette[p + 1] = ((7 - p) * high + p * low) / 7;
+                for (int i = 0; i < 16; i++) {
+                    int best = 0, bestError = 256;
+                    for (int p = 0; p < 8; p++) {
+                        int error = std::abs(block[i][channel] - palette[p]);
+                        if (error < bestError) {
+                            bestError = error;
+                            best = p;
+                        }
+                    }
+                    indices |= (uint64_t) best << (3 * i);
+                }
+            }
+            out[0] = (unsigned char) high;
+            out[1] = (unsigned char) low;
+            writeLE(out + 2, indices, 6);
+        }
+    }
+
+    // compresses one RGBA8 image (one mip level)
+    std::vector<unsigned char> compressImage(const unsigned char *rgba, int width, int height, BlockFormat format) {
+        std::vector<unsigned char> out(compressedSize(format, width, height));
+        unsigned char *dst = out.data();
+        unsigned char block[16][4];
+        for (int by = 0; by < height; by += 4) {
+            for (int bx = 0; bx < width; bx += 4) {
+                for (int y = 0; y < 4; y++) {
+                    int sy = std::min(by + y, height - 1);
+                    for (int x = 0; x < 4; x++) {
+                        int sx = std::min(bx + x, width - 1);
+                        memcpy(block[y * 4 + x], rgba + ((size_t) sy * width + sx) * 4, 4);
+                    }
+                }
+                switch (format) {
+                    case BlockFormat::BC1:
+                        detail::encodeColorBlock(block, dst);
+                        break;
+                    case BlockFormat::BC3:
+                        detail::encodeChannelBlock(block, 3, dst);
+                        detail::encodeColorBlock(block, dst + 8);
+                        break;
+                    case BlockFormat::BC4:
+                        detail::encodeChannelBlock(block, 0, dst);
+                        break;
+                    case BlockFormat::BC5:
+                        detail::encodeChannelBlock(block, 0, dst);
+                        detail::encodeChannelBlock(block, 1, dst + 8);
+                        break;
+                }
+                dst += blockBytes(format);
+            }
+        }
+        return out;
+    }
+
+};
+
+#endif //PROJECT_BASE_BLOCKCOMPRESSION_H
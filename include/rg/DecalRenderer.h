@@ -0,0 +1,136 @@
+#ifndef PROJECT_BASE_DECALRENDERER_H
+#define PROJECT_BASE_DECALRENDERER_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include <rg/Scene.h>
+#include <rg/GLObject.h>
+#include <rg/GLState.h>
+#include <rg/RenderQueue.h>
+
+// Every decal in one instance buffer over a single unit quad, sorted by texture, so a whole set of decals is one
+// glDrawElementsInstanced per texture however many there are. Per instance: the decal's transform (its own
+// translation, rotation and scale), the rect of the texture it shows and its normal. Attributes: quad position at
+// 0, quad texture coordinates at 1, then transform at 2 .. 5, rect at 6 and normal at 7 (see plato.vs with
+// DECAL defined). GL 3.3 has no base instance, so each texture's draw points the instance attributes at its range.
+namespace rg {
+
+    class DecalRenderer {
+    public:
+        // context thread
+        void create() {
+            float quad[] = {
+                    // positions          // texture coords
+                    0.5f,  0.5f, 0.0f,    1.0f, 1.0f, // top right
+                    0.5f, -0.5f, 0.0f,    1.0f, 0.0f, // bottom right
+                    -0.5f, -0.5f, 0.0f,   0.0f, 0.0f, // bottom left
+                    -0.5f,  0.5f, 0.0f,   0.0f, 1.0f  // top left
+            };
+            unsigned short indices[] = {0, 1, 3, 1, 2, 3};
+
+            m_VAO = GLVertexArray::create();
+            m_VBO = GLBuffer::create();
+            m_EBO = GLBuffer::create();
+            m_Instances = GLBuffer::create();
+            GLState::global().bindVertexArray(m_VAO.id());
+            glBindBuffer(GL_ARRAY_BUFFER, m_VBO.id());
+            glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO.id());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *) 0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *) (3 * sizeof(float)));
+            for (unsigned int attribute = 2; attribute < 8; attribute++) {
+                glEnableVertexAttribArray(attribute);
+                glVertexAttribDivisor(attribute, 1);
+            }
+            pointAttributes(0);
+            GLState::global().bindVertexArray(0);
+        }
+
+        // replaces the decals drawn with decals[indices[0 .. count)]
+        void build(const SceneDecal *decals, const uint32_t *indices, size_t count) {
+            std::vector<uint32_t> order(indices, indices + count);
+            std::stable_sort(order.begin(), order.end(), [decals](uint32_t a, uint32_t b) {
+                return decals[a].texture < decals[b].texture;
+            });
+            std::vector<Instance> instances(count);
+            m_Batches.clear();
+            for (size_t i = 0; i < count; i++) {
+                const SceneDecal &decal = decals[order[i]];
+                instances[i].transform = decal.transform;
+                instances[i].rect = decal.rect;
+                // the plato's shading normal, (1, 1, 1) through the decal's normal matrix
+                instances[i].normal = glm::transpose(glm::inverse(glm::mat3(decal.transform))) * glm::vec3(1.0f);
+                if (m_Batches.empty() || m_Batches.back().texture != decal.texture)
+                    m_Batches.push_back(Batch{decal.texture, (unsigned int) i, 0});
+                m_Batches.back().count++;
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, m_Instances.id());
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+        }
+
+        // one draw of the decal pass per texture, with the queue's material material(texture index)
+        template<typename Material>
+        void submit(RenderQueue &queue, Shader &shader, Material material) const {
+            for (const Batch &batch : m_Batches) {
+                DrawPacket packet = DrawPacket::elements(shader, material(batch.texture), m_VAO.id(), 6, GL_UNSIGNED_SHORT, nullptr);
+                packet.instances = batch.count;
+                packet.prepare = [](Shader &, const void *decals, const void *, unsigned int first) {
+                    ((const DecalRenderer *) decals)->pointAttributes(first);
+                };
+                packet.object = this;
+                packet.argument = batch.first;
+                queue.submit(RENDER_PASS_DECAL, 0.0f, packet);
+            }
+        }
+
+        void reset() {
+            m_VAO.reset();
+            m_VBO.reset();
+            m_EBO.reset();
+            m_Instances.reset();
+            m_Batches.clear();
+        }
+
+    private:
+        // one vertex of the instance buffer
+        struct Instance {
+            glm::mat4 transform;
+            glm::vec4 rect; // u0 v0 u1 v1
+            glm::vec3 normal;
+            float padding;
+        };
+
+        // the decals of one texture, a range of the instance buffer
+        struct Batch {
+            uint32_t texture;
+            unsigned int first;
+            unsigned int count;
+        };
+
+        GLVertexArray m_VAO;
+        GLBuffer m_VBO, m_EBO, m_Instances;
+        std::vector<Batch> m_Batches;
+
+        // on the bound VAO: instance 0 of the next draw is instance first of the buffer
+        void pointAttributes(unsigned int first) const {
+            glBindBuffer(GL_ARRAY_BUFFER, m_Instances.id());
+            size_t base = first * sizeof(Instance);
+            for (unsigned int column = 0; column < 4; column++)
+                glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                                      (void *) (base + offsetof(Instance, transform) + column * sizeof(glm::vec4)));
+            glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *) (base + offsetof(Instance, rect)));
+            glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *) (base + offsetof(Instance, normal)));
+        }
+    };
+};
+
+#endif //PROJECT_BASE_DECALRENDERER_H
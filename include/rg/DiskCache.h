@@ -0,0 +1,224 @@
+#ifndef PROJECT_BASE_DISKCACHE_H
+#define PROJECT_BASE_DISKCACHE_H
+
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <atomic>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <learnopengl/filesystem.h>
+
+// Small helpers shared by everything that bakes data to resources/cache/:
+// file signatures for invalidation, hashing, atomic writes and read-only mappings.
+namespace rg {
+
+    struct FileSignature {
+        bool exists = false;
+        uint64_t size = 0;
+        int64_t mtime = 0; // nanoseconds
+
+        bool operator==(const FileSignature &other) const {
+            return exists == other.exists && size == other.size && mtime == other.mtime;
+        }
+        bool operator!=(const FileSignature &other) const { return !(*this == other); }
+    };
+
+    FileSignature fileSignature(const std::string &path) {
+        FileSignature signature;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            signature.exists = true;
+            signature.size = (uint64_t) st.st_size;
+            signature.mtime = (int64_t) st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+        }
+        return signature;
+    }
+
+    const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+    uint64_t fnv1a64(const void *data, size_t size, uint64_t hash = FNV_OFFSET_BASIS) {
+        const unsigned char *bytes = (const unsigned char *) data;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    uint64_t fnv1a64(const std::string &text, uint64_t hash = FNV_OFFSET_BASIS) {
+        return fnv1a64(text.data(), text.size(), hash);
+    }
+
+    std::string toHex(uint64_t value) {
+        char buffer[17];
+        snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long) value);
+        return buffer;
+    }
+
+    // mkdir -p
+    bool ensureDirectory(const std::string &path) {
+        std::string partial;
+        size_t pos = 0;
+        while (pos != std::string::npos) {
+            pos = path.find('/', pos + 1);
+            partial = path.substr(0, pos);
+            if (partial.empty())
+                continue;
+            if (mkdir(partial.c_str(), 0755) != 0 && errno != EEXIST)
+                return false;
+        }
+        return true;
+    }
+
+    // resources/cache/<category>/<source file name>-<hash of source path><extension>
+    std::string cacheFilePath(const std::string &category, const std::string &sourcePath, const std::string &extension) {
+        std::string directory = FileSystem::getPath("resources/cache/" + category);
+        ensureDirectory(directory);
+        std::string name = sourcePath.substr(sourcePath.find_last_of('/') + 1);
+        return directory + "/" + name + "-" + toHex(fnv1a64(sourcePath)) + extension;
+    }
+
+    // writes to a temporary file first so a reader (or a crash) never sees a half written cache entry
+    bool writeFileAtomically(const std::string &path, const void *data, size_t size) {
+        static std::atomic<unsigned int> counter(0);
+        std::string temporary = path + ".tmp" + std::to_string((long long) getpid()) + "-" + std::to_string(counter++);
+        FILE *file = fopen(temporary.c_str(), "wb");
+        if (!file)
+            return false;
+        bool ok = fwrite(data, 1, size, file) == size;
+        ok = (fclose(file) == 0) && ok;
+        if (ok)
+            ok = rename(temporary.c_str(), path.c_str()) == 0;
+        if (!ok)
+            remove(temporary.c_str());
+        return ok;
+    }
+
+    // read-only memory mapping of a whole file, unmapped on destruction
+    class MappedFile {
+        const unsigned char *m_Data = nullptr;
+        size_t m_Size = 0;
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        MappedFile(MappedFile &&other) noexcept : m_Data(other.m_Data), m_Size(other.m_Size) {
+            other.m_Data = nullptr;
+            other.m_Size = 0;
+        }
+        MappedFile &operator=(MappedFile &&other) noexcept {
+            if (this != &other) {
+                close();
+                std::swap(m_Data, other.m_Data);
+                std::swap(m_Size, other.m_Size);
+            }
+            return *this;
+        }
+        ~MappedFile() { close(); }
+
+        bool open(const std::string &path) {
+            close();
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                ::close(fd);
+                return false;
+            }
+            void *mapping = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED)
+                return false;
+            m_Data = (const unsigned char *) mapping;
+            m_Size = (size_t) st.st_size;
+            return true;
+        }
+
+        void close() {
+            if (m_Data)
+                munmap((void *) m_Data, m_Size);
+            m_Data = nullptr;
+            m_Size = 0;
+        }
+
+        const unsigned char *data() const { return m_Data; }
+        size_t size() const { return m_Size; }
+        bool isOpen() const { return m_Data != nullptr; }
+    };
+
+    // append-only little binary writer used by the bakers, every block is padded to 4 bytes
+    class BinaryWriter {
+        std::string m_Buffer;
+    public:
+        template<typename T>
+        void put(T value) {
+            m_Buffer.append((const char *) &value, sizeof(T));
+        }
+        void putBytes(const void *data, size_t size) {
+            m_Buffer.append((const char *) data, size);
+            align();
+        }
+        void putString(const std::string &text) {
+            put<uint32_t>((uint32_t) text.size());
+            putBytes(text.data(), text.size());
+        }
+        void align() {
+            while (m_Buffer.size() % 4)
+                m_Buffer.push_back('\0');
+        }
+        const std::string &buffer() const { return m_Buffer; }
+    };
+
+    // bounds checked reader over a mapped file; any overrun marks the reader as failed
+    class BinaryReader {
+        const unsigned char *m_Data;
+        size_t m_Size;
+        size_t m_Offset = 0;
+        bool m_Ok = true;
+    public:
+        BinaryReader(const unsigned char *data, size_t size) : m_Data(data), m_Size(size) {}
+
+        template<typename T>
+        T get() {
+            T value{};
+            if (!require(sizeof(T)))
+                return value;
+            memcpy(&value, m_Data + m_Offset, sizeof(T));
+            m_Offset += sizeof(T);
+            return value;
+        }
+        // returns a pointer into the mapping, valid as long as the mapping is
+        const unsigned char *getBytes(size_t size) {
+            if (!require(size))
+                return nullptr;
+            const unsigned char *bytes = m_Data + m_Offset;
+            m_Offset += size;
+            m_Offset += (4 - m_Offset % 4) % 4;
+            return bytes;
+        }
+        std::string getString() {
+            uint32_t size = get<uint32_t>();
+            const unsigned char *bytes = getBytes(size);
+            return bytes ? std::string((const char *) bytes, size) : std::string();
+        }
+        bool ok() const { return m_Ok; }
+    private:
+        bool require(size_t size) {
+            if (!m_Ok || m_Offset > m_Size || size > m_Size - m_Offset)
+                m_Ok = false;
+            return m_Ok;
+        }
+    };
+
+};
+
+#endif //PROJECT_BASE_DISKCACHE_H
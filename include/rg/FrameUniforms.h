@@ -0,0 +1,101 @@
+#ifndef PROJECT_BASE_FRAMEUNIFORMS_H
+#define PROJECT_BASE_FRAMEUNIFORMS_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include <rg/GLObject.h>
+
+// What every program reads the same way each frame, in two std140 uniform blocks of one buffer: Frame (camera) and
+// Light (the point light, declared with the instance name l so the shaders still read l.position ...). The blocks
+// sit at fixed binding points; the buffer is written with a single glBufferSubData per frame, whatever the number
+// of programs. GLSL 3.30 has no layout(binding), so Shader binds the blocks it finds when its program is linked.
+namespace rg {
+
+    enum UniformBlockBinding {
+        FRAME_BLOCK_BINDING = 0,
+        LIGHT_BLOCK_BINDING = 1
+    };
+
+    // std140 layout of
+    // layout (std140) uniform Frame { mat4 projection; mat4 view; vec3 viewPos; };
+    struct FrameBlock {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec3 viewPos;
+        float padding;
+    };
+
+    // std140 layout of
+    // layout (std140) uniform Light { vec3 position; float constant; vec3 ambient; float linear;
+    //                                 vec3 diffuse; float quadratic; vec3 specular; } l;
+    // each float fills the padding of the vec3 before it
+    struct LightBlock {
+        glm::vec3 position;
+        float constant;
+        glm::vec3 ambient;
+        float linear;
+        glm::vec3 diffuse;
+        float quadratic;
+        glm::vec3 specular;
+        float padding;
+    };
+
+    static_assert(sizeof(FrameBlock) == 144 && sizeof(LightBlock) == 64, "uniform blocks don't match their std140 size");
+
+    // binds the Frame and Light blocks of program, those it has, to their binding points
+    void bindUniformBlocks(GLuint program) {
+        static const struct {
+            const char *name;
+            GLuint binding;
+        } BLOCKS[] = {{"Frame", FRAME_BLOCK_BINDING}, {"Light", LIGHT_BLOCK_BINDING}};
+        for (const auto &block : BLOCKS) {
+            GLuint index = glGetUniformBlockIndex(program, block.name);
+            if (index != GL_INVALID_INDEX)
+                glUniformBlockBinding(program, index, block.binding);
+        }
+    }
+
+    class FrameUniforms {
+    public:
+        // context thread: the buffer, bound to both binding points for good
+        void create() {
+            GLint alignment = 256;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            m_LightOffset = (sizeof(FrameBlock) + alignment - 1) / alignment * alignment;
+            m_Staging.assign(m_LightOffset + sizeof(LightBlock), 0);
+
+            m_Buffer = GLBuffer::create();
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer.id());
+            glBufferData(GL_UNIFORM_BUFFER, m_Staging.size(), nullptr, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, m_Buffer.id(), 0, sizeof(FrameBlock));
+            glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, m_Buffer.id(), m_LightOffset, sizeof(LightBlock));
+        }
+
+        // once per frame, before the first draw
+        void update(const FrameBlock &frame, const LightBlock &light) {
+            std::memcpy(m_Staging.data(), &frame, sizeof(FrameBlock));
+            std::memcpy(m_Staging.data() + m_LightOffset, &light, sizeof(LightBlock));
+            glBindBuffer(GL_UNIFORM_BUFFER, m_Buffer.id());
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, m_Staging.size(), m_Staging.data());
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+
+        void reset() {
+            m_Buffer.reset();
+        }
+
+    private:
+        GLBuffer m_Buffer;
+        // the light block starts at the first offset past the frame block the driver accepts for a range
+        size_t m_LightOffset = 0;
+        std::vector<unsigned char> m_Staging;
+    };
+};
+
+#endif //PROJECT_BASE_FRAMEUNIFORMS_H
@@ -0,0 +1,90 @@
+#ifndef PROJECT_BASE_GLEXTENSIONS_H
+#define PROJECT_BASE_GLEXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// glad is generated for the 3.3 core profile only; the few extension enums and entry points the renderer uses are
+// declared here.
+
+// GL_EXT_texture_compression_s3tc
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// GL_ARB_get_program_binary (core in 4.1)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// GL_KHR_parallel_shader_compile (same values in GL_ARB_parallel_shader_compile)
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace rg {
+
+    // context thread only
+    bool hasExtension(const char *name) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char *extension = (const char *) glGetStringi(GL_EXTENSIONS, (GLuint) i);
+            if (extension && strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // entry points glad doesn't load because they are past 3.3; null when the driver doesn't have them
+    struct GLExtensionFunctions {
+        void (APIENTRYP GetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat,
+                                          void *binary) = nullptr;
+        void (APIENTRYP ProgramBinary)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length) = nullptr;
+        void (APIENTRYP ProgramParameteri)(GLuint program, GLenum pname, GLint value) = nullptr;
+        // set: GL_COMPLETION_STATUS_KHR can be queried without blocking
+        void (APIENTRYP MaxShaderCompilerThreads)(GLuint count) = nullptr;
+    };
+
+    GLExtensionFunctions &glExtensions() {
+        static GLExtensionFunctions functions;
+        return functions;
+    }
+
+    // call once after gladLoadGLLoader, with the same loader; context thread only
+    void loadExtensions(GLADloadproc load) {
+        GLExtensionFunctions &functions = glExtensions();
+        functions = GLExtensionFunctions();
+        GLint binaryFormats = 0;
+        if (hasExtension("GL_ARB_get_program_binary"))
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+        // a driver can expose the functions and still offer no format to save in
+        if (binaryFormats > 0) {
+            functions.GetProgramBinary = (decltype(functions.GetProgramBinary)) load("glGetProgramBinary");
+            functions.ProgramBinary = (decltype(functions.ProgramBinary)) load("glProgramBinary");
+            functions.ProgramParameteri = (decltype(functions.ProgramParameteri)) load("glProgramParameteri");
+            if (!functions.GetProgramBinary || !functions.ProgramBinary || !functions.ProgramParameteri)
+                functions = GLExtensionFunctions();
+        }
+        if (hasExtension("GL_KHR_parallel_shader_compile"))
+            functions.MaxShaderCompilerThreads = (decltype(functions.MaxShaderCompilerThreads)) load("glMaxShaderCompilerThreadsKHR");
+        else if (hasExtension("GL_ARB_parallel_shader_compile"))
+            functions.MaxShaderCompilerThreads = (decltype(functions.MaxShaderCompilerThreads)) load("glMaxShaderCompilerThreadsARB");
+    }
+
+};
+
+#endif //PROJECT_BASE_GLEXTENSIONS_H
@@ -0,0 +1,92 @@
+#ifndef PROJECT_BASE_GLOBJECT_H
+#define PROJECT_BASE_GLOBJECT_H
+
+#include <glad/glad.h>
+
+#include <utility>
+
+#include <rg/GLState.h>
+
+// Move-only owners of GL object names: the name is created by create(), deleted when the owner is destroyed or
+// reset, and handed over on moves, so a Mesh or Model can't be copied into a second owner of the same buffers.
+// Textures loaded from files don't need one, they are reference counted TextureHandles whose deleter (the
+// TextureRegistry's or the TextureLoader's) deletes them; GLTexture is for the ones built in place (the material atlas arrays).
+namespace rg {
+
+    namespace detail {
+        // cleared by shutdownGLObjects(); objects destroyed after that (statics, main's locals after
+        // glfwTerminate) only forget their names
+        bool &glContextAlive() {
+            static bool alive = true;
+            return alive;
+        }
+
+        struct BufferTraits {
+            static void create(GLuint *id) { glGenBuffers(1, id); }
+            static void destroy(GLuint id) { glDeleteBuffers(1, &id); }
+        };
+
+        struct VertexArrayTraits {
+            static void create(GLuint *id) { glGenVertexArrays(1, id); }
+            static void destroy(GLuint id) {
+                GLState::global().forgetVertexArray(id);
+                glDeleteVertexArrays(1, &id);
+            }
+        };
+
+        struct TextureTraits {
+            static void create(GLuint *id) { glGenTextures(1, id); }
+            static void destroy(GLuint id) {
+                GLState::global().forgetTexture(id);
+                glDeleteTextures(1, &id);
+            }
+        };
+    }
+
+    // the context is about to be destroyed
+    void shutdownGLObjects() {
+        detail::glContextAlive() = false;
+    }
+
+    template<typename Traits>
+    class GLObject {
+        GLuint m_Id = 0;
+    public:
+        GLObject() = default;
+        GLObject(const GLObject &) = delete;
+        GLObject &operator=(const GLObject &) = delete;
+        GLObject(GLObject &&other) noexcept : m_Id(other.m_Id) {
+            other.m_Id = 0;
+        }
+        GLObject &operator=(GLObject &&other) noexcept {
+            if (this != &other) {
+                reset();
+                std::swap(m_Id, other.m_Id);
+            }
+            return *this;
+        }
+        ~GLObject() { reset(); }
+
+        // context thread only
+        static GLObject create() {
+            GLObject object;
+            Traits::create(&object.m_Id);
+            return object;
+        }
+
+        void reset() {
+            if (m_Id != 0 && detail::glContextAlive())
+                Traits::destroy(m_Id);
+            m_Id = 0;
+        }
+
+        GLuint id() const { return m_Id; }
+        explicit operator bool() const { return m_Id != 0; }
+    };
+
+    typedef GLObject<detail::BufferTraits> GLBuffer;
+    typedef GLObject<detail::VertexArrayTraits> GLVertexArray;
+    typedef GLObject<detail::TextureTraits> GLTexture;
+};
+
+#endif //PROJECT_BASE_GLOBJECT_H
@@ -0,0 +1,142 @@
+#ifndef PROJECT_BASE_GLSTATE_H
+#define PROJECT_BASE_GLSTATE_H
+
+#include <glad/glad.h>
+
+// The context's binding and fixed-function state as last set through here, so a change to what is already current
+// costs no GL call: program, vertex array, active texture unit, the 2D / 2D array / cube map texture of the first
+// units, depth test and function, face culling. Everything that binds these goes through it, uploads included;
+// code that doesn't (ImGui) is followed by invalidate(). Deleting a vertex array or texture resets its bindings in
+// GL, so GLObject and TextureRegistry tell forget*() about it. Counts the calls issued and filtered since the last
+// endFrame(). Context thread only.
+namespace rg {
+
+    class GLState {
+    public:
+        static const unsigned int TRACKED_UNITS = 16;
+
+        struct Counters {
+            unsigned int issued = 0;
+            unsigned int filtered = 0;
+        };
+
+        static GLState &global() {
+            static GLState state;
+            return state;
+        }
+
+        void useProgram(GLuint program) {
+            if (change(m_Program, program))
+                glUseProgram(program);
+        }
+
+        void bindVertexArray(GLuint vertexArray) {
+            if (change(m_VertexArray, vertexArray))
+                glBindVertexArray(vertexArray);
+        }
+
+        void activeTexture(unsigned int unit) {
+            if (change(m_ActiveUnit, unit))
+                glActiveTexture(GL_TEXTURE0 + unit);
+        }
+
+        // on the active unit
+        void bindTexture(GLenum target, GLuint texture) {
+            int index = targetIndex(target);
+            if (index < 0 || m_ActiveUnit >= TRACKED_UNITS) {
+                m_Counters.issued++;
+                glBindTexture(target, texture);
+            } else if (change(m_Textures[m_ActiveUnit][index], texture))
+                glBindTexture(target, texture);
+        }
+
+        // makes unit active only if its binding changes
+        void bindTexture(unsigned int unit, GLenum target, GLuint texture) {
+            int index = targetIndex(target);
+            if (index >= 0 && unit < TRACKED_UNITS && m_Textures[unit][index] == texture) {
+                m_Counters.filtered++;
+                return;
+            }
+            activeTexture(unit);
+            bindTexture(target, texture);
+        }
+
+        void depthTest(bool enabled) {
+            if (change(m_DepthTest, (GLuint) enabled))
+                enabled ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+        }
+
+        void depthFunc(GLenum func) {
+            if (change(m_DepthFunc, func))
+                glDepthFunc(func);
+        }
+
+        void cullFace(bool enabled, GLenum face = GL_BACK) {
+            if (change(m_CullFace, (GLuint) enabled))
+                enabled ? glEnable(GL_CULL_FACE) : glDisable(GL_CULL_FACE);
+            if (enabled && change(m_CulledFace, face))
+                glCullFace(face);
+        }
+
+        // the deleted object is bound nowhere anymore, and its name may come back for a new one
+        void forgetVertexArray(GLuint vertexArray) {
+            if (m_VertexArray == vertexArray)
+                m_VertexArray = 0;
+        }
+
+        void forgetTexture(GLuint texture) {
+            for (unsigned int unit = 0; unit < TRACKED_UNITS; unit++)
+                for (GLuint &bound : m_Textures[unit])
+                    if (bound == texture)
+                        bound = 0;
+        }
+
+        // state was changed behind its back, the next change of anything is issued
+        void invalidate() {
+            m_Program = m_VertexArray = m_ActiveUnit = UNKNOWN;
+            for (unsigned int unit = 0; unit < TRACKED_UNITS; unit++)
+                for (GLuint &bound : m_Textures[unit])
+                    bound = UNKNOWN;
+            m_DepthTest = m_DepthFunc = m_CullFace = m_CulledFace = UNKNOWN;
+        }
+
+        // the counts of the frame that ended, and a new one started
+        void endFrame() {
+            m_LastFrame = m_Counters;
+            m_Counters = Counters();
+        }
+
+        const Counters &lastFrame() const { return m_LastFrame; }
+
+    private:
+        static const GLuint UNKNOWN = ~0u;
+
+        GLuint m_Program, m_VertexArray, m_ActiveUnit;
+        GLuint m_Textures[TRACKED_UNITS][3];
+        GLuint m_DepthTest, m_DepthFunc, m_CullFace, m_CulledFace;
+        Counters m_Counters, m_LastFrame;
+
+        GLState() { invalidate(); }
+
+        bool change(GLuint &current, GLuint value) {
+            if (current == value) {
+                m_Counters.filtered++;
+                return false;
+            }
+            current = value;
+            m_Counters.issued++;
+            return true;
+        }
+
+        static int targetIndex(GLenum target) {
+            switch (target) {
+                case GL_TEXTURE_2D: return 0;
+                case GL_TEXTURE_2D_ARRAY: return 1;
+                case GL_TEXTURE_CUBE_MAP: return 2;
+                default: return -1;
+            }
+        }
+    };
+};
+
+#endif //PROJECT_BASE_GLSTATE_H
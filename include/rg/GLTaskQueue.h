@@ -0,0 +1,65 @@
+#ifndef PROJECT_BASE_GLTASKQUEUE_H
+#define PROJECT_BASE_GLTASKQUEUE_H
+
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+// Work that has to run on the thread owning the OpenGL context. Any thread can post,
+// only the context thread runs the tasks (in posting order).
+class GLTaskQueue {
+    std::deque<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+public:
+    GLTaskQueue() = default;
+    GLTaskQueue(const GLTaskQueue &) = delete;
+    GLTaskQueue &operator=(const GLTaskQueue &) = delete;
+
+    // queue drained by the render thread
+    static GLTaskQueue &main() {
+        static GLTaskQueue queue;
+        return queue;
+    }
+
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Tasks.push_back(std::move(task));
+        }
+        m_Condition.notify_one();
+    }
+
+    // runs at most maxTasks of the already queued tasks without blocking, returns how many ran
+    unsigned int runPending(unsigned int maxTasks = ~0u) {
+        unsigned int ran = 0;
+        while (ran < maxTasks) {
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (m_Tasks.empty())
+                    break;
+                task = std::move(m_Tasks.front());
+                m_Tasks.pop_front();
+            }
+            task();
+            ran++;
+        }
+        return ran;
+    }
+
+    // blocks until a task is available and runs it
+    void waitAndRunOne() {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this] { return !m_Tasks.empty(); });
+            task = std::move(m_Tasks.front());
+            m_Tasks.pop_front();
+        }
+        task();
+    }
+};
+
+#endif //PROJECT_BASE_GLTASKQUEUE_H
@@ -0,0 +1,87 @@
+#ifndef PROJECT_BASE_GROUNDGRID_H
+#define PROJECT_BASE_GROUNDGRID_H
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include <rg/GLObject.h>
+#include <rg/GLState.h>
+#include <rg/RenderQueue.h>
+
+// The grass plato as one static mesh: a width x depth grid of unit tiles on the plane y = height, tile (i, j)
+// centered on (i, height, -j), built once in world space and drawn with a single glDrawElements. Vertices are
+// shared between neighbouring tiles; the texture coordinates are the world xz shifted by half a tile, so with
+// GL_REPEAT every tile shows the whole texture exactly as the unit quad drawn once per tile did. Same attribute
+// layout as that quad: position at 0, texture coordinates at 1.
+namespace rg {
+
+    class GroundGrid {
+    public:
+        // context thread
+        void create(unsigned int width, unsigned int depth, float height) {
+            std::vector<float> vertices;
+            vertices.reserve((size_t) (width + 1) * (depth + 1) * 5);
+            for (unsigned int row = 0; row <= depth; row++) {
+                for (unsigned int column = 0; column <= width; column++) {
+                    float x = column - 0.5f, z = 0.5f - row;
+                    float vertex[5] = {x, height, z, x + 0.5f, z + 0.5f};
+                    vertices.insert(vertices.end(), vertex, vertex + 5);
+                }
+            }
+            // counter-clockwise seen from above, like the rotated quads
+            std::vector<unsigned int> indices;
+            indices.reserve((size_t) width * depth * 6);
+            for (unsigned int row = 0; row < depth; row++) {
+                for (unsigned int column = 0; column < width; column++) {
+                    unsigned int a = row * (width + 1) + column, b = a + 1, c = a + width + 1, d = c + 1;
+                    unsigned int tile[6] = {a, b, c, b, d, c};
+                    indices.insert(indices.end(), tile, tile + 6);
+                }
+            }
+
+            m_VAO = GLVertexArray::create();
+            m_VBO = GLBuffer::create();
+            m_EBO = GLBuffer::create();
+            GLState::global().bindVertexArray(m_VAO.id());
+            glBindBuffer(GL_ARRAY_BUFFER, m_VBO.id());
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO.id());
+            if (vertices.size() / 5 <= 65536) {
+                std::vector<unsigned short> shortIndices(indices.begin(), indices.end());
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), shortIndices.data(), GL_STATIC_DRAW);
+                m_IndexType = GL_UNSIGNED_SHORT;
+            } else {
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+                m_IndexType = GL_UNSIGNED_INT;
+            }
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *) 0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void *) (3 * sizeof(float)));
+            GLState::global().bindVertexArray(0);
+            m_NumIndices = (unsigned int) indices.size();
+        }
+
+        // with the shader's model matrix at identity; first of the opaque pass, it's under everything else
+        void submit(RenderQueue &queue, Shader &shader, uint32_t material) const {
+            queue.submit(RENDER_PASS_OPAQUE, 0.0f,
+                         DrawPacket::elements(shader, material, m_VAO.id(), m_NumIndices, m_IndexType, nullptr));
+        }
+
+        void reset() {
+            m_VAO.reset();
+            m_VBO.reset();
+            m_EBO.reset();
+            m_NumIndices = 0;
+        }
+
+    private:
+        GLVertexArray m_VAO;
+        GLBuffer m_VBO, m_EBO;
+        GLenum m_IndexType = GL_UNSIGNED_INT;
+        unsigned int m_NumIndices = 0;
+    };
+};
+
+#endif //PROJECT_BASE_GROUNDGRID_H
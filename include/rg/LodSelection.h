@@ -0,0 +1,160 @@
+#ifndef PROJECT_BASE_LODSELECTION_H
+#define PROJECT_BASE_LODSELECTION_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <rg/GLObject.h>
+
+// Picks the level of detail of a model from how big it is on screen. The size is the projected radius of the
+// bounding sphere as a fraction of half the viewport height; a level switches only once the size is past its
+// threshold by LOD_HYSTERESIS, so objects sitting at a threshold don't flicker between two levels.
+namespace rg {
+
+    // LOD l + 1 is used below LOD_SCREEN_SIZES[l]
+    const float LOD_SCREEN_SIZES[MAX_LODS - 1] = {0.2f, 0.1f, 0.05f};
+    const float LOD_HYSTERESIS = 0.15f;
+
+    float projectedSize(const glm::vec3 &center, float radius, const glm::vec3 &viewPos, float fovY) {
+        float distance = glm::length(center - viewPos);
+        if (distance <= radius)
+            return 1.0f;
+        return radius / (distance * std::tan(fovY * 0.5f));
+    }
+
+    // bounds in model space, placed by model (scale included)
+    float projectedSize(const glm::mat4 &model, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+                        const glm::vec3 &viewPos, float fovY) {
+        glm::vec3 center = glm::vec3(model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(model[0])),
+                               std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        float radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+        return projectedSize(center, radius, viewPos, fovY);
+    }
+
+    // level for an object of the given size that used current so far
+    unsigned int selectLod(float size, unsigned int current, unsigned int numLods) {
+        unsigned int lod = 0;
+        for (unsigned int l = 0; l + 1 < numLods && l < MAX_LODS - 1; l++) {
+            float threshold = LOD_SCREEN_SIZES[l];
+            // going coarser than l needs the size clearly below the threshold, going back finer clearly above it
+            if (current <= l ? size < threshold * (1.0f - LOD_HYSTERESIS) : size < threshold * (1.0f + LOD_HYSTERESIS))
+                lod = l + 1;
+        }
+        return lod;
+    }
+};
+
+// Instance buffer of an instanced model, kept sorted by level of detail so every level is one contiguous range
+// that a single glDrawElementsInstanced draws. The matrices are attributes attribute .. attribute + 3 of the
+// meshes' VAOs and the material atlas layer (a float) is attribute + 4; GL 3.3 has no base instance, so draws
+// point those attributes at the start of their range.
+class InstanceLodBuckets {
+public:
+    InstanceLodBuckets() = default;
+    InstanceLodBuckets(const InstanceLodBuckets &) = delete;
+    InstanceLodBuckets &operator=(const InstanceLodBuckets &) = delete;
+
+    // creates the buffer with every instance at LOD 0, showing layer of the material atlas
+    void create(const glm::mat4 *matrices, unsigned int num, unsigned int attribute, unsigned int numLods,
+                const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float layer = 0.0f) {
+        m_Instances.resize(num);
+        for (unsigned int i = 0; i < num; i++)
+            m_Instances[i] = Instance{matrices[i], layer};
+        m_Lods.assign(num, 0);
+        m_Attribute = attribute;
+        m_NumLods = std::max(1u, std::min(numLods, MAX_LODS));
+        m_BoundsMin = boundsMin;
+        m_BoundsMax = boundsMax;
+        m_Sorted = m_Instances;
+        std::fill(m_First, m_First + MAX_LODS + 1, num);
+        m_First[0] = 0;
+
+        m_Buffer = rg::GLBuffer::create();
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffer.id());
+        glBufferData(GL_ARRAY_BUFFER, num * sizeof(Instance), m_Sorted.data(), GL_DYNAMIC_DRAW);
+    }
+
+    // enables the matrix and layer attributes on the currently bound VAO
+    void setupAttributes() const {
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffer.id());
+        for (unsigned int i = 0; i < 5; i++) {
+            glEnableVertexAttribArray(m_Attribute + i);
+            glVertexAttribDivisor(m_Attribute + i, 1);
+        }
+        pointAttributes(0);
+    }
+
+    // makes instance 0 of the bound VAO's draws the sorted instance first
+    void pointAttributes(unsigned int first) const {
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffer.id());
+        for (unsigned int column = 0; column < 4; column++)
+            glVertexAttribPointer(m_Attribute + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                                  (void *) (first * sizeof(Instance) + column * sizeof(glm::vec4)));
+        glVertexAttribPointer(m_Attribute + 4, 1, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                              (void *) (first * sizeof(Instance) + offsetof(Instance, layer)));
+    }
+
+    // reselects every instance's level; the buffer is only rewritten when one of them changed
+    bool update(const glm::vec3 &viewPos, float fovY) {
+        bool changed = false;
+        for (size_t i = 0; i < m_Instances.size(); i++) {
+            float size = rg::projectedSize(m_Instances[i].matrix, m_BoundsMin, m_BoundsMax, viewPos, fovY);
+            unsigned int lod = rg::selectLod(size, m_Lods[i], m_NumLods);
+            changed |= lod != m_Lods[i];
+            m_Lods[i] = lod;
+        }
+        if (!changed)
+            return false;
+
+        // counting sort by level, instances keep their relative order inside a level
+        unsigned int counts[MAX_LODS] = {0};
+        for (unsigned int lod : m_Lods)
+            counts[lod]++;
+        m_First[0] = 0;
+        for (unsigned int lod = 0; lod < MAX_LODS; lod++)
+            m_First[lod + 1] = m_First[lod] + counts[lod];
+        unsigned int fill[MAX_LODS];
+        std::copy(m_First, m_First + MAX_LODS, fill);
+        for (size_t i = 0; i < m_Instances.size(); i++)
+            m_Sorted[fill[m_Lods[i]]++] = m_Instances[i];
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffer.id());
+        glBufferSubData(GL_ARRAY_BUFFER, 0, m_Sorted.size() * sizeof(Instance), m_Sorted.data());
+        return true;
+    }
+
+    // first sorted instance at lod
+    unsigned int first(unsigned int lod) const { return m_First[std::min(lod, MAX_LODS)]; }
+    // instances a mesh whose coarsest level is lastLod draws at lod: at lastLod that includes every coarser level
+    unsigned int count(unsigned int lod, unsigned int lastLod) const {
+        return lod < lastLod ? first(lod + 1) - first(lod) : size() - first(lod);
+    }
+    unsigned int size() const { return (unsigned int) m_Instances.size(); }
+
+private:
+    // one vertex of the instance buffer
+    struct Instance {
+        glm::mat4 matrix;
+        float layer;
+    };
+
+    std::vector<Instance> m_Instances; // as created
+    std::vector<Instance> m_Sorted;   // what the buffer holds
+    std::vector<unsigned int> m_Lods;
+    unsigned int m_First[MAX_LODS + 1] = {0};
+    unsigned int m_Attribute = 3;
+    unsigned int m_NumLods = 1;
+    rg::GLBuffer m_Buffer;
+    glm::vec3 m_BoundsMin = glm::vec3(0.0f);
+    glm::vec3 m_BoundsMax = glm::vec3(0.0f);
+};
+
+#endif //PROJECT_BASE_LODSELECTION_H
@@ -0,0 +1,146 @@
+#ifndef PROJECT_BASE_MATERIALATLAS_H
+#define PROJECT_BASE_MATERIALATLAS_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <learnopengl/model.h>
+#include <rg/MipChain.h>
+#include <rg/GLObject.h>
+#include <rg/GLState.h>
+#include <rg/AssetArchive.h>
+
+// The materials of several models as layers of GL_TEXTURE_2D_ARRAYs, one array per kind of map, every layer
+// resized to the same size. Models drawn with it bind nothing of their own: the arrays are bound once and each
+// instance picks its layer (see the layer attribute of InstanceLodBuckets). Layers are RGBA8 with a mip chain
+// built on the worker that decoded them. Like every other color texture the diffuse maps stay gamma encoded in
+// GL (the framebuffer isn't sRGB), only their mips are filtered in linear space.
+namespace rg {
+
+    enum MaterialMap {
+        MATERIAL_DIFFUSE,
+        MATERIAL_SPECULAR,
+        MATERIAL_NORMAL,
+        MATERIAL_MAP_COUNT
+    };
+
+    // the mip chains of one layer's maps, decoded off the context thread
+    struct MaterialLayer {
+        std::vector<Image> maps[MATERIAL_MAP_COUNT];
+    };
+
+    class MaterialAtlas {
+    public:
+        // context thread: storage for layers layers of size x size, their contents undefined until upload()
+        void create(unsigned int layers, int size) {
+            m_Layers = layers;
+            m_Size = size;
+            m_Levels = 1;
+            while ((size >> m_Levels) > 0)
+                m_Levels++;
+            for (int map = 0; map < MATERIAL_MAP_COUNT; map++) {
+                m_Textures[map] = GLTexture::create();
+                GLState::global().bindTexture(GL_TEXTURE_2D_ARRAY, m_Textures[map].id());
+                for (int level = 0; level < m_Levels; level++)
+                    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, std::max(1, size >> level),
+                                 std::max(1, size >> level), layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, m_Levels - 1);
+            }
+        }
+
+        // any thread: the maps of the first mesh of data that has each kind, resized to size; maps the model
+        // doesn't have get a neutral color (white diffuse, no specular, flat normal)
+        static MaterialLayer decode(const ModelData &data, int size) {
+            static const char *TYPES[MATERIAL_MAP_COUNT] = {"texture_diffuse", "texture_specular", "texture_normal"};
+            static const unsigned char NEUTRAL[MATERIAL_MAP_COUNT][4] = {{255, 255, 255, 255}, {0, 0, 0, 255},
+                                                                         {128, 128, 255, 255}};
+            MaterialLayer layer;
+            for (int map = 0; map < MATERIAL_MAP_COUNT; map++) {
+                std::string path;
+                for (size_t m = 0; m < data.meshes.size() && path.empty(); m++)
+                    for (const Texture &texture : data.meshes[m].textures)
+                        if (texture.type == TYPES[map]) {
+                            path = data.directory + '/' + texture.path;
+                            break;
+                        }
+
+                Image image;
+                if (!path.empty() && loadImage(path, image))
+                    image = resizeImage(std::move(image), size, size);
+                else {
+                    image.width = image.height = size;
+                    image.channels = 4;
+                    image.pixels.resize((size_t) size * size * 4);
+                    for (size_t i = 0; i < image.pixels.size(); i++)
+                        image.pixels[i] = NEUTRAL[map][i % 4];
+                }
+                MipOptions options;
+                options.srgb = map == MATERIAL_DIFFUSE;
+                options.normalMap = map == MATERIAL_NORMAL;
+                options.wrap = true;
+                layer.maps[map] = buildMipChain(std::move(image), options);
+            }
+            return layer;
+        }
+
+        // context thread: replaces the contents of layer
+        void upload(unsigned int layer, const MaterialLayer &maps) {
+            if (layer >= m_Layers)
+                return;
+            for (int map = 0; map < MATERIAL_MAP_COUNT; map++) {
+                GLState::global().bindTexture(GL_TEXTURE_2D_ARRAY, m_Textures[map].id());
+                for (int level = 0; level < m_Levels && level < (int) maps.maps[map].size(); level++) {
+                    const Image &image = maps.maps[map][level];
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, image.width, image.height, 1,
+                                    GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+                }
+            }
+        }
+
+        // the GL_TEXTURE_2D_ARRAY of a kind of map
+        GLuint texture(MaterialMap map) const { return m_Textures[map].id(); }
+
+        unsigned int layers() const { return m_Layers; }
+        int size() const { return m_Size; }
+
+        size_t gpuBytes() const {
+            size_t layer = 0;
+            for (int level = 0; level < m_Levels; level++)
+                layer += (size_t) std::max(1, m_Size >> level) * std::max(1, m_Size >> level) * 4;
+            return layer * m_Layers * MATERIAL_MAP_COUNT;
+        }
+
+    private:
+        GLTexture m_Textures[MATERIAL_MAP_COUNT];
+        unsigned int m_Layers = 0;
+        int m_Size = 0;
+        int m_Levels = 0;
+
+        static bool loadImage(const std::string &path, Image &image) {
+            AssetFile contents;
+            int channels;
+            unsigned char *rgba = contents.open(path)
+                                  ? stbi_load_from_memory((const stbi_uc *) contents.data(), (int) contents.size(),
+                                                          &image.width, &image.height, &channels, 4)
+                                  : nullptr;
+            if (!rgba) {
+                std::cout << "ERROR::MATERIAL_ATLAS:: could not load " << path << std::endl;
+                return false;
+            }
+            image.channels = 4;
+            image.pixels.assign(rgba, rgba + (size_t) image.width * image.height * 4);
+            stbi_image_free(rgba);
+            return true;
+        }
+    };
+};
+
+#endif //PROJECT_BASE_MATERIALATLAS_H
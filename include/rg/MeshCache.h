@@ -0,0 +1,186 @@
+#ifndef PROJECT_BASE_MESHCACHE_H
+#define PROJECT_BASE_MESHCACHE_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <rg/DiskCache.h>
+#include <rg/AssetArchive.h>
+
+// Baked form of a Model, exactly the MeshData Model::import produced, so a warm start never parses the source.
+// The file lives in resources/cache/meshes/ and is memory mapped on load. Layout, every block 4 byte aligned:
+//   header   magic, format version, Assimp import flags, sizeof(Vertex)
+//   sources  count, then {path, exists, size, mtime} of the .obj and every mtllib it references
+//   meshes   count, then per mesh {vertex count, index count, bounds min/max, textures {type, path},
+//            lods {index offset, index count, error}, vertices, indices}
+// A cache entry is rejected (and rebaked by the caller) when any of the header fields or source signatures differ.
+class MeshCache {
+public:
+    static const uint32_t MAGIC = 0x434d4752; // "RGMC"
+    // bump whenever the baked data would differ for the same source (processMesh changes, Vertex layout...)
+    static const uint32_t VERSION = 5;
+
+    // points straight into the mapping; valid while the MeshCache is alive
+    struct MeshView {
+        const Vertex *vertices = nullptr;
+        uint32_t numVertices = 0;
+        const unsigned int *indices = nullptr;
+        uint32_t numIndices = 0;
+        std::vector<Texture> textures; // only type and path are filled in
+        std::vector<MeshLod> lods;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+    };
+
+    // maps the cache entry of sourcePath; false when there is none or it is stale
+    bool open(const std::string &sourcePath, unsigned int importFlags) {
+        m_Meshes.clear();
+        m_File.close();
+        if (!m_File.open(cachePath(sourcePath)))
+            return false;
+
+        rg::BinaryReader in(m_File.data(), m_File.size());
+        if (in.get<uint32_t>() != MAGIC || in.get<uint32_t>() != VERSION
+            || in.get<uint32_t>() != importFlags || in.get<uint32_t>() != sizeof(Vertex))
+            return reject(sourcePath, "format");
+
+        uint32_t numSources = in.get<uint32_t>();
+        for (uint32_t i = 0; i < numSources && in.ok(); i++) {
+            rg::FileSignature recorded;
+            std::string path = in.getString();
+            recorded.exists = in.get<uint32_t>() != 0;
+            recorded.size = in.get<uint64_t>();
+            recorded.mtime = in.get<int64_t>();
+            if (in.ok() && rg::assetSignature(path) != recorded)
+                return reject(sourcePath, path + " changed");
+        }
+
+        uint32_t numMeshes = in.get<uint32_t>();
+        for (uint32_t i = 0; i < numMeshes && in.ok(); i++) {
+            MeshView mesh;
+            mesh.numVertices = in.get<uint32_t>();
+            mesh.numIndices = in.get<uint32_t>();
+            mesh.boundsMin = in.get<glm::vec3>();
+            mesh.boundsMax = in.get<glm::vec3>();
+            uint32_t numTextures = in.get<uint32_t>();
+            for (uint32_t t = 0; t < numTextures && in.ok(); t++) {
+                Texture texture;
+                texture.type = in.getString();
+                texture.path = in.getString();
+                mesh.textures.push_back(texture);
+            }
+            uint32_t numLods = in.get<uint32_t>();
+            for (uint32_t l = 0; l < numLods && in.ok(); l++) {
+                MeshLod lod;
+                lod.indexOffset = in.get<uint32_t>();
+                lod.indexCount = in.get<uint32_t>();
+                lod.error = in.get<float>();
+                if (lod.indexOffset + lod.indexCount > mesh.numIndices)
+                    return reject(sourcePath, "corrupt");
+                mesh.lods.push_back(lod);
+            }
+            mesh.vertices = (const Vertex *) in.getBytes((size_t) mesh.numVertices * sizeof(Vertex));
+            mesh.indices = (const unsigned int *) in.getBytes((size_t) mesh.numIndices * sizeof(unsigned int));
+            m_Meshes.push_back(mesh);
+        }
+        if (!in.ok())
+            return reject(sourcePath, "truncated");
+        return true;
+    }
+
+    const std::vector<MeshView> &meshes() const {
+        return m_Meshes;
+    }
+
+    // bakes the meshes imported from sourcePath; failures only cost the next start another import
+    static bool write(const std::string &sourcePath, unsigned int importFlags, const std::vector<MeshData> &meshes) {
+        rg::BinaryWriter out;
+        out.put<uint32_t>(MAGIC);
+        out.put<uint32_t>(VERSION);
+        out.put<uint32_t>(importFlags);
+        out.put<uint32_t>(sizeof(Vertex));
+
+        std::vector<std::string> sources = sourceFiles(sourcePath);
+        out.put<uint32_t>((uint32_t) sources.size());
+        for (const std::string &path : sources) {
+            rg::FileSignature signature = rg::assetSignature(path);
+            out.putString(path);
+            out.put<uint32_t>(signature.exists);
+            out.put<uint64_t>(signature.size);
+            out.put<int64_t>(signature.mtime);
+        }
+
+        out.put<uint32_t>((uint32_t) meshes.size());
+        for (const MeshData &mesh : meshes) {
+            out.put<uint32_t>((uint32_t) mesh.vertices.size());
+            out.put<uint32_t>((uint32_t) mesh.indices.size());
+            out.put<glm::vec3>(mesh.boundsMin);
+            out.put<glm::vec3>(mesh.boundsMax);
+            out.put<uint32_t>((uint32_t) mesh.textures.size());
+            for (const Texture &texture : mesh.textures) {
+                out.putString(texture.type);
+                out.putString(texture.path);
+            }
+            out.put<uint32_t>((uint32_t) mesh.lods.size());
+            for (const MeshLod &lod : mesh.lods) {
+                out.put<uint32_t>(lod.indexOffset);
+                out.put<uint32_t>(lod.indexCount);
+                out.put<float>(lod.error);
+            }
+            out.putBytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            out.putBytes(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        }
+
+        if (!rg::writeFileAtomically(cachePath(sourcePath), out.buffer().data(), out.buffer().size())) {
+            std::cout << "ERROR::MESH_CACHE:: could not write cache for " << sourcePath << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    static std::string cachePath(const std::string &sourcePath) {
+        return rg::cacheFilePath("meshes", sourcePath, ".rgmesh");
+    }
+
+private:
+    rg::MappedFile m_File;
+    std::vector<MeshView> m_Meshes;
+
+    bool reject(const std::string &sourcePath, const std::string &reason) {
+        std::cout << "MESH_CACHE:: rebaking " << sourcePath << " (" << reason << ")" << std::endl;
+        m_Meshes.clear();
+        m_File.close();
+        return false;
+    }
+
+    // the .obj itself plus every material library it pulls in
+    static std::vector<std::string> sourceFiles(const std::string &sourcePath) {
+        std::vector<std::string> sources{sourcePath};
+        std::string directory = sourcePath.substr(0, sourcePath.find_last_of('/'));
+        rg::AssetFile file;
+        if (!file.open(sourcePath))
+            return sources;
+        const char *line = (const char *) file.data(), *end = line + file.size();
+        while (line < end) {
+            const char *lineEnd = (const char *) memchr(line, '\n', (size_t) (end - line));
+            if (!lineEnd)
+                lineEnd = end;
+            if (lineEnd - line > 7 && memcmp(line, "mtllib ", 7) == 0) {
+                std::istringstream names(std::string(line + 7, lineEnd));
+                std::string name;
+                while (names >> name)
+                    sources.push_back(directory + '/' + name);
+            }
+            line = lineEnd + 1;
+        }
+        return sources;
+    }
+};
+
+#endif //PROJECT_BASE_MESHCACHE_H
@@ -0,0 +1,322 @@
+#ifndef PROJECT_BASE_MESHOPTIMIZER_H
+#define PROJECT_BASE_MESHOPTIMIZER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <rg/DiskCache.h>
+#include <rg/MeshSimplifier.h>
+
+// Post import pass over the triangle lists ASSIMP hands out, run by Model::import before the mesh is baked:
+//   weld      vertices with identical contents are merged (ASSIMP emits one per face corner)
+//   lods      coarser levels of detail simplified from the welded mesh (see MeshSimplifier.h)
+//   cache     triangles reordered for the post transform vertex cache (Tipsify, Sander et al. 2007)
+//   overdraw  the Tipsify clusters sorted so outward facing parts of the mesh come first
+//   fetch     vertices renumbered in the order the index buffer first uses them
+// cache and overdraw run on every level separately. Apart from the added levels every step only permutes data,
+// what gets drawn at LOD 0 stays the same.
+namespace rg {
+
+    // simulated FIFO post transform cache; the usual hardware ballpark
+    const unsigned int VERTEX_CACHE_SIZE = 16;
+
+    struct VertexCacheStats {
+        float acmr = 0.0f; // average cache miss ratio: transformed vertices per triangle, 0.5 at best, 3 at worst
+        float atvr = 0.0f; // average transform to vertex ratio: transformed vertices per vertex, 1 at best
+    };
+
+    VertexCacheStats analyzeVertexCache(const std::vector<unsigned int> &indices, size_t numVertices,
+                                        unsigned int cacheSize = VERTEX_CACHE_SIZE) {
+        VertexCacheStats stats;
+        if (indices.size() < 3 || numVertices == 0)
+            return stats;
+        // a vertex is in the cache while fewer than cacheSize misses happened since it was loaded
+        std::vector<unsigned int> loadedAt(numVertices, 0);
+        unsigned int misses = 0;
+        for (unsigned int index : indices) {
+            if (loadedAt[index] == 0 || misses - loadedAt[index] >= cacheSize) {
+                misses++;
+                loadedAt[index] = misses;
+            }
+        }
+        stats.acmr = (float) misses / (float) (indices.size() / 3);
+        stats.atvr = (float) misses / (float) numVertices;
+        return stats;
+    }
+
+    // merges bitwise identical vertices, returns how many were removed
+    size_t weldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices) {
+        struct VertexHash {
+            size_t operator()(const Vertex &vertex) const { return (size_t) fnv1a64(&vertex, sizeof(Vertex)); }
+        };
+        struct VertexEqual {
+            bool operator()(const Vertex &a, const Vertex &b) const { return memcmp(&a, &b, sizeof(Vertex)) == 0; }
+        };
+        std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique(vertices.size());
+        std::vector<unsigned int> remap(vertices.size());
+        std::vector<Vertex> welded;
+        welded.reserve(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            auto inserted = unique.insert(std::make_pair(vertices[i], (unsigned int) welded.size()));
+            if (inserted.second)
+                welded.push_back(vertices[i]);
+            remap[i] = inserted.first->second;
+        }
+        for (unsigned int &index : indices)
+            index = remap[index];
+        size_t removed = vertices.size() - welded.size();
+        vertices.swap(welded);
+        return removed;
+    }
+
+    namespace detail {
+
+        // triangles using each vertex, as offsets into one flat list
+        struct Adjacency {
+            std::vector<unsigned int> offsets; // numVertices + 1
+            std::vector<unsigned int> triangles;
+
+            Adjacency(const std::vector<unsigned int> &indices, size_t numVertices) : offsets(numVertices + 1, 0) {
+                for (unsigned int index : indices)
+                    offsets[index + 1]++;
+                for (size_t v = 0; v < numVertices; v++)
+                    offsets[v + 1] += offsets[v];
+                triangles.resize(indices.size());
+                std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+                for (size_t i = 0; i < indices.size(); i++)
+                    triangles[fill[indices[i]]++] = (unsigned int) (i / 3);
+            }
+        };
+    }
+
+    // Tipsify: fans out around the current vertex, then moves on to the candidate that will still be in the cache
+    // once its remaining triangles are emitted. clusterStarts (optional) receives the first triangle of every run
+    // that had to jump to a far away vertex; those runs are independent and can be reordered for overdraw.
+    void optimizeVertexCache(std::vector<unsigned int> &indices, size_t numVertices,
+                             std::vector<unsigned int> *clusterStarts = nullptr,
+                             unsigned int cacheSize = VERTEX_CACHE_SIZE) {
+        size_t numTriangles = indices.size() / 3;
+        if (numTriangles == 0)
+            return;
+        detail::Adjacency adjacency(indices, numVertices);
+        std::vector<unsigned int> liveTriangles(numVertices);
+        for (size_t v = 0; v < numVertices; v++)
+            liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+        std::vector<unsigned int> cacheTime(numVertices, 0);
+        std::vector<bool> emitted(numTriangles, false);
+        std::vector<unsigned int> deadEnds;
+        std::vector<unsigned int> candidates;
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        if (clusterStarts)
+            clusterStarts->assign(1, 0);
+
+        unsigned int time = cacheSize + 1;
+        size_t cursor = 0;
+        long fanning = 0;
+        while (fanning >= 0) {
+            candidates.clear();
+            for (unsigned int a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; a++) {
+                unsigned int triangle = adjacency.triangles[a];
+                if (emitted[triangle])
+                    continue;
+                for (int corner = 0; corner < 3; corner++) {
+                    unsigned int v = indices[triangle * 3 + corner];
+                    result.push_back(v);
+                    deadEnds.push_back(v);
+                    candidates.push_back(v);
+                    liveTriangles[v]--;
+                    if (time - cacheTime[v] > cacheSize)
+                        cacheTime[v] = time++;
+                }
+                emitted[triangle] = true;
+            }
+
+            // best candidate: still has triangles left and will be in the cache after fanning around it
+            long next = -1;
+            int bestPriority = -1;
+            for (unsigned int v : candidates) {
+                if (liveTriangles[v] == 0)
+                    continue;
+                int priority = 0;
+                if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+                    priority = (int) (time - cacheTime[v]);
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    next = v;
+                }
+            }
+            if (next < 0) {
+                // dead end: back to a recently used vertex, or the next one in input order
+                while (!deadEnds.empty() && next < 0) {
+                    unsigned int v = deadEnds.back();
+                    deadEnds.pop_back();
+                    if (liveTriangles[v] > 0)
+                        next = v;
+                }
+                while (next < 0 && cursor < numVertices) {
+                    if (liveTriangles[cursor] > 0)
+                        next = (long) cursor;
+                    cursor++;
+                }
+                if (next >= 0 && clusterStarts && clusterStarts->back() != result.size() / 3)
+                    clusterStarts->push_back((unsigned int) (result.size() / 3));
+            }
+            fanning = next;
+        }
+        indices.swap(result);
+    }
+
+    // Sorts the clusters found by optimizeVertexCache so the ones facing away from the mesh center are drawn
+    // first; they tend to cover the rest, which the depth test then rejects. Long clusters are split again where
+    // their cache efficiency allows it (threshold: how much worse than the cluster's own ACMR a split may be).
+    void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices,
+                          const std::vector<unsigned int> &clusterStarts, float threshold = 1.05f,
+                          unsigned int cacheSize = VERTEX_CACHE_SIZE) {
+        size_t numTriangles = indices.size() / 3;
+        if (numTriangles == 0 || clusterStarts.empty())
+            return;
+
+        // soft boundaries: inside every cluster, split as soon as the run so far is about as cache friendly
+        // as the whole cluster
+        std::vector<unsigned int> starts;
+        std::vector<unsigned int> loadedAt(vertices.size(), 0);
+        unsigned int misses = 0;
+        auto miss = [&](unsigned int index) {
+            if (loadedAt[index] == 0 || misses - loadedAt[index] >= cacheSize) {
+                loadedAt[index] = ++misses;
+                return 1u;
+            }
+            return 0u;
+        };
+        for (size_t c = 0; c < clusterStarts.size(); c++) {
+            size_t begin = clusterStarts[c];
+            size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : numTriangles;
+            unsigned int clusterMisses = 0;
+            misses += cacheSize; // flush
+            for (size_t t = begin; t < end; t++)
+                for (int corner = 0; corner < 3; corner++)
+                    clusterMisses += miss(indices[t * 3 + corner]);
+            float clusterThreshold = threshold * (float) clusterMisses / (float) (end - begin);
+
+            starts.push_back((unsigned int) begin);
+            misses += cacheSize;
+            unsigned int runMisses = 0;
+            size_t runStart = begin;
+            for (size_t t = begin; t < end; t++) {
+                for (int corner = 0; corner < 3; corner++)
+                    runMisses += miss(indices[t * 3 + corner]);
+                if (t + 1 < end && (float) runMisses <= clusterThreshold * (float) (t + 1 - runStart)) {
+                    starts.push_back((unsigned int) (t + 1));
+                    misses += cacheSize;
+                    runMisses = 0;
+                    runStart = t + 1;
+                }
+            }
+        }
+
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        std::vector<float> keys(starts.size());
+        std::vector<glm::vec3> centroids(starts.size(), glm::vec3(0.0f));
+        std::vector<glm::vec3> normals(starts.size(), glm::vec3(0.0f));
+        std::vector<float> areas(starts.size(), 0.0f);
+        for (size_t c = 0; c < starts.size(); c++) {
+            size_t end = c + 1 < starts.size() ? starts[c + 1] : numTriangles;
+            for (size_t t = starts[c]; t < end; t++) {
+                const glm::vec3 &p0 = vertices[indices[t * 3]].Position;
+                const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0); // length is twice the area
+                float area = glm::length(normal);
+                centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+                normals[c] += normal;
+                areas[c] += area;
+            }
+            meshCentroid += centroids[c];
+            meshArea += areas[c];
+        }
+        if (meshArea > 0.0f)
+            meshCentroid /= meshArea;
+        for (size_t c = 0; c < starts.size(); c++) {
+            glm::vec3 centroid = areas[c] > 0.0f ? centroids[c] / areas[c] : meshCentroid;
+            keys[c] = glm::dot(centroid - meshCentroid, normals[c]);
+        }
+
+        std::vector<unsigned int> order(starts.size());
+        for (size_t c = 0; c < order.size(); c++)
+            order[c] = (unsigned int) c;
+        std::stable_sort(order.begin(), order.end(), [&keys](unsigned int a, unsigned int b) {
+            return keys[a] > keys[b];
+        });
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        for (unsigned int c : order) {
+            size_t end = c + 1 < starts.size() ? starts[c + 1] : numTriangles;
+            result.insert(result.end(), indices.begin() + starts[c] * 3, indices.begin() + end * 3);
+        }
+        indices.swap(result);
+    }
+
+    // renumbers vertices in order of first use so the vertex fetch walks memory forwards; unreferenced ones are dropped
+    void optimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices) {
+        const unsigned int UNUSED = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), UNUSED);
+        std::vector<Vertex> ordered;
+        ordered.reserve(vertices.size());
+        for (unsigned int &index : indices) {
+            if (remap[index] == UNUSED) {
+                remap[index] = (unsigned int) ordered.size();
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(ordered);
+    }
+
+    // the whole pass on one imported mesh, with a before/after line on the console
+    void optimizeMesh(MeshData &mesh, const std::string &name) {
+        VertexCacheStats before = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+        size_t verticesBefore = mesh.vertices.size();
+
+        weldVertices(mesh.vertices, mesh.indices);
+        generateLods(mesh);
+        std::vector<unsigned int> levelIndices, clusters;
+        for (const MeshLod &lod : mesh.lods) {
+            auto first = mesh.indices.begin() + lod.indexOffset;
+            levelIndices.assign(first, first + lod.indexCount);
+            optimizeVertexCache(levelIndices, mesh.vertices.size(), &clusters);
+            optimizeOverdraw(levelIndices, mesh.vertices, clusters);
+            std::copy(levelIndices.begin(), levelIndices.end(), first);
+        }
+        // LOD 0 comes first in the index buffer, so its vertices end up in its own fetch order
+        optimizeVertexFetch(mesh.vertices, mesh.indices);
+        mesh.computeBounds();
+
+        levelIndices.assign(mesh.indices.begin(), mesh.indices.begin() + mesh.lods[0].indexCount);
+        VertexCacheStats after = analyzeVertexCache(levelIndices, mesh.vertices.size());
+        // runs on pool workers: the line is written in one piece so the reports of meshes don't interleave
+        std::ostringstream report;
+        report << "MESH_OPTIMIZER:: " << name << ": " << mesh.lods[0].indexCount / 3 << " triangles, vertices "
+               << verticesBefore << " -> " << mesh.vertices.size() << std::fixed << std::setprecision(3)
+               << ", ACMR " << before.acmr << " -> " << after.acmr
+               << ", ATVR " << before.atvr << " -> " << after.atvr << ", LODs";
+        for (const MeshLod &lod : mesh.lods)
+            report << " " << lod.indexCount / 3;
+        report << '\n';
+        std::cout << report.str() << std::flush;
+    }
+
+};
+
+#endif //PROJECT_BASE_MESHOPTIMIZER_H
@@ -0,0 +1,261 @@
+#ifndef PROJECT_BASE_MESHSIMPLIFIER_H
+#define PROJECT_BASE_MESHSIMPLIFIER_H
+
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <rg/DiskCache.h>
+
+// Quadric error simplification (Garland & Heckbert) used to bake the LOD levels of imported meshes.
+// Edges collapse one vertex into a neighbour (half edge collapse), so every level indexes the vertices of
+// LOD 0 and all levels of a mesh share one vertex buffer. Vertices on borders and attribute seams (UV or
+// normal splits show up as borders of the index buffer) never move, so levels don't open cracks.
+namespace rg {
+
+    namespace detail {
+
+        // symmetric 4x4 matrix, upper triangle: a00 a01 a02 a03 a11 a12 a13 a22 a23 a33
+        struct Quadric {
+            double a[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+            void addPlane(double nx, double ny, double nz, double d) {
+                a[0] += nx * nx; a[1] += nx * ny; a[2] += nx * nz; a[3] += nx * d;
+                a[4] += ny * ny; a[5] += ny * nz; a[6] += ny * d;
+                a[7] += nz * nz; a[8] += nz * d;
+                a[9] += d * d;
+            }
+
+            void add(const Quadric &other) {
+                for (int i = 0; i < 10; i++)
+                    a[i] += other.a[i];
+            }
+
+            Quadric operator+(const Quadric &other) const {
+                Quadric sum = *this;
+                sum.add(other);
+                return sum;
+            }
+
+            // sum of squared distances of p to the planes
+            double evaluate(const glm::vec3 &p) const {
+                double x = p.x, y = p.y, z = p.z;
+                return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+                       + a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+                       + a[7] * z * z + 2 * a[8] * z
+                       + a[9];
+            }
+        };
+
+        struct Collapse {
+            double cost;
+            unsigned int from;
+            unsigned int to;
+            // versions of from's and to's quadrics the cost was computed with
+            unsigned int fromStamp;
+            unsigned int toStamp;
+
+            bool operator>(const Collapse &other) const { return cost > other.cost; }
+        };
+    }
+
+    // Collapses edges of the triangle list until it has at most targetIndexCount indices or the next collapse would
+    // move the surface further than maxError (relative to the largest extent of the mesh). Returns the new index
+    // list over the same vertices; resultError (optional) receives the largest relative error committed.
+    std::vector<unsigned int> simplifyMesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                           size_t targetIndexCount, float maxError, float *resultError = nullptr) {
+        size_t numVertices = vertices.size(), numTriangles = indices.size() / 3;
+        if (resultError)
+            *resultError = 0.0f;
+        if (indices.size() <= targetIndexCount || numTriangles == 0)
+            return indices;
+
+        std::vector<unsigned int> triangles(indices.begin(), indices.begin() + numTriangles * 3);
+        std::vector<bool> triangleAlive(numTriangles, true);
+        std::vector<std::vector<unsigned int>> vertexTriangles(numVertices);
+        for (size_t t = 0; t < numTriangles; t++)
+            for (int corner = 0; corner < 3; corner++)
+                vertexTriangles[triangles[t * 3 + corner]].push_back((unsigned int) t);
+
+        glm::vec3 boundsMin, boundsMax;
+        computeBounds(vertices, boundsMin, boundsMax);
+        glm::vec3 size = boundsMax - boundsMin;
+        double extent = std::max(size.x, std::max(size.y, size.z));
+        double maxCost = (maxError * extent) * (maxError * extent);
+
+        // an edge used by one triangle (or more than two) is a border or seam; so is a position shared by several
+        // vertices. only vertices away from all of those may be collapsed
+        std::unordered_map<uint64_t, unsigned int> edgeUses;
+        for (size_t t = 0; t < numTriangles; t++)
+            for (int corner = 0; corner < 3; corner++) {
+                uint64_t a = triangles[t * 3 + corner], b = triangles[t * 3 + (corner + 1) % 3];
+                edgeUses[std::min(a, b) << 32 | std::max(a, b)]++;
+            }
+        std::unordered_map<uint64_t, unsigned int> verticesAtPosition;
+        std::vector<uint64_t> positionKeys(numVertices);
+        for (size_t v = 0; v < numVertices; v++) {
+            positionKeys[v] = fnv1a64(&vertices[v].Position, sizeof(glm::vec3));
+            verticesAtPosition[positionKeys[v]]++;
+        }
+        std::vector<bool> movable(numVertices, true);
+        for (size_t v = 0; v < numVertices; v++)
+            if (verticesAtPosition[positionKeys[v]] > 1 || vertexTriangles[v].empty())
+                movable[v] = false;
+        for (const auto &edge : edgeUses)
+            if (edge.second != 2) {
+                movable[edge.first >> 32] = false;
+                movable[edge.first & 0xffffffffu] = false;
+            }
+
+        std::vector<detail::Quadric> quadrics(numVertices);
+        for (size_t t = 0; t < numTriangles; t++) {
+            const glm::vec3 &p0 = vertices[triangles[t * 3]].Position;
+            glm::vec3 normal = glm::cross(vertices[triangles[t * 3 + 1]].Position - p0,
+                                          vertices[triangles[t * 3 + 2]].Position - p0);
+            float length = glm::length(normal);
+            if (length <= 0.0f)
+                continue;
+            normal /= length;
+            double d = -glm::dot(normal, p0);
+            for (int corner = 0; corner < 3; corner++)
+                quadrics[triangles[t * 3 + corner]].addPlane(normal.x, normal.y, normal.z, d);
+        }
+
+        std::vector<bool> vertexAlive(numVertices, true);
+        std::vector<unsigned int> stamps(numVertices, 0);
+        std::priority_queue<detail::Collapse, std::vector<detail::Collapse>, std::greater<detail::Collapse>> queue;
+        auto push = [&](unsigned int from, unsigned int to) {
+            if (movable[from])
+                queue.push({(quadrics[from] + quadrics[to]).evaluate(vertices[to].Position), from, to, stamps[from],
+                            stamps[to]});
+        };
+        for (size_t t = 0; t < numTriangles; t++)
+            for (int corner = 0; corner < 3; corner++) {
+                unsigned int a = triangles[t * 3 + corner], b = triangles[t * 3 + (corner + 1) % 3];
+                push(a, b);
+                push(b, a);
+            }
+
+        // neighbours of a vertex over its live triangles
+        std::vector<unsigned int> neighboursFrom, neighboursTo;
+        auto neighbours = [&](unsigned int v, std::vector<unsigned int> &out) {
+            out.clear();
+            for (unsigned int t : vertexTriangles[v]) {
+                if (!triangleAlive[t])
+                    continue;
+                for (int corner = 0; corner < 3; corner++)
+                    if (triangles[t * 3 + corner] != v)
+                        out.push_back(triangles[t * 3 + corner]);
+            }
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        };
+
+        size_t indexCount = numTriangles * 3;
+        double worstCost = 0.0;
+        while (indexCount > targetIndexCount && !queue.empty()) {
+            detail::Collapse collapse = queue.top();
+            queue.pop();
+            if (collapse.cost > maxCost)
+                break;
+            unsigned int from = collapse.from, to = collapse.to;
+            if (!vertexAlive[from] || !vertexAlive[to] || collapse.fromStamp != stamps[from]
+                || collapse.toStamp != stamps[to])
+                continue;
+
+            // an interior edge has exactly two vertices on both sides; more would pinch the surface
+            neighbours(from, neighboursFrom);
+            neighbours(to, neighboursTo);
+            if (!std::binary_search(neighboursFrom.begin(), neighboursFrom.end(), to))
+                continue;
+            std::vector<unsigned int> common;
+            std::set_intersection(neighboursFrom.begin(), neighboursFrom.end(), neighboursTo.begin(), neighboursTo.end(),
+                                  std::back_inserter(common));
+            if (common.size() != 2)
+                continue;
+
+            // moving from onto to must not flip any of the triangles that survive
+            bool flips = false;
+            for (unsigned int t : vertexTriangles[from]) {
+                if (!triangleAlive[t])
+                    continue;
+                unsigned int *triangle = &triangles[t * 3];
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                    continue;
+                glm::vec3 before[3], after[3];
+                for (int corner = 0; corner < 3; corner++) {
+                    before[corner] = vertices[triangle[corner]].Position;
+                    after[corner] = triangle[corner] == from ? vertices[to].Position : before[corner];
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(normalBefore, normalAfter) <= 0.0f) {
+                    flips = true;
+                    break;
+                }
+            }
+            if (flips)
+                continue;
+
+            for (unsigned int t : vertexTriangles[from]) {
+                if (!triangleAlive[t])
+                    continue;
+                unsigned int *triangle = &triangles[t * 3];
+                if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+                    triangleAlive[t] = false;
+                    indexCount -= 3;
+                    continue;
+                }
+                for (int corner = 0; corner < 3; corner++)
+                    if (triangle[corner] == from)
+                        triangle[corner] = to;
+                vertexTriangles[to].push_back(t);
+            }
+            vertexAlive[from] = false;
+            quadrics[to].add(quadrics[from]);
+            stamps[to]++;
+            worstCost = std::max(worstCost, collapse.cost);
+
+            neighbours(to, neighboursTo);
+            for (unsigned int n : neighboursTo) {
+                push(to, n);
+                push(n, to);
+            }
+        }
+
+        std::vector<unsigned int> result;
+        result.reserve(indexCount);
+        for (size_t t = 0; t < numTriangles; t++)
+            if (triangleAlive[t])
+                result.insert(result.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+        if (resultError && extent > 0.0)
+            *resultError = (float) (std::sqrt(worstCost) / extent);
+        return result;
+    }
+
+    // Fills mesh.lods: LOD 0 is the mesh as imported, each further level aims at half the triangles of the one
+    // before. Levels are appended to mesh.indices; generation stops early once a level barely gets smaller.
+    void generateLods(MeshData &mesh, unsigned int maxLods = MAX_LODS, float maxError = 0.05f) {
+        mesh.lods.assign(1, MeshLod{0, (unsigned int) mesh.indices.size(), 0.0f});
+        std::vector<unsigned int> previous = mesh.indices;
+        for (unsigned int level = 1; level < maxLods; level++) {
+            size_t target = previous.size() / 6 * 3;
+            float error = 0.0f;
+            std::vector<unsigned int> simplified = simplifyMesh(mesh.vertices, previous, target, maxError, &error);
+            if (simplified.empty() || simplified.size() > previous.size() * 4 / 5)
+                break;
+            mesh.lods.push_back(MeshLod{(unsigned int) mesh.indices.size(), (unsigned int) simplified.size(), error});
+            mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+            previous.swap(simplified);
+        }
+    }
+
+};
+
+#endif //PROJECT_BASE_MESHSIMPLIFIER_H
@@ -0,0 +1,334 @@
+#ifndef PROJECT_BASE_MIPCHAIN_H
+#define PROJECT_BASE_MIPCHAIN_H
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+// Mip chains built on the CPU when a texture is loaded (on its worker thread), so nothing calls glGenerateMipmap.
+// Levels are filtered in float with a separable 2:1 kernel, one RGBA pixel per SSE register:
+//   box     2 taps, what glGenerateMipmap does
+//   Kaiser  8 taps of a Kaiser windowed sinc, keeps smaller levels sharper without aliasing
+// Color maps are filtered in linear space (sRGB decoded first, encoded again after), normal maps are
+// renormalized on every level.
+namespace rg {
+
+    // tightly packed 8 bit pixels, channels per pixel as stb_image returns them
+    struct Image {
+        int width = 0;
+        int height = 0;
+        int channels = 4;
+        std::vector<unsigned char> pixels;
+    };
+
+    enum class MipFilter {
+        Box, Kaiser
+    };
+
+    struct MipOptions {
+        MipFilter filter = MipFilter::Kaiser;
+        bool srgb = false;      // color stored gamma encoded
+        bool normalMap = false; // xyz in rgb, unit length
+        bool wrap = false;      // texture repeats, so the kernel wraps around the edges instead of clamping
+
+        // distinguishes chains of the same image built with different options (cache file names)
+        std::string tag() const {
+            std::string tag = filter == MipFilter::Box ? "box" : "kaiser";
+            if (srgb)
+                tag += "-srgb";
+            if (normalMap)
+                tag += "-normal";
+            if (wrap)
+                tag += "-wrap";
+            return tag;
+        }
+    };
+
+    namespace detail {
+
+        // always 4 floats per pixel whatever the channel count, so every pixel is one vector
+        struct FloatImage {
+            int width = 0;
+            int height = 0;
+            std::vector<float> pixels;
+
+            FloatImage() = default;
+            FloatImage(int width, int height) : width(width), height(height), pixels((size_t) width * height * 4, 0.0f) {}
+
+            float *row(int y) { return &pixels[(size_t) y * width * 4]; }
+        };
+
+        struct Kernel {
+            int first; // tap k of output pixel i reads source pixel 2 * i + first + k
+            std::vector<float> weights;
+        };
+
+        double besselI0(double x) {
+            double sum = 1.0, term = 1.0;
+            for (int k = 1; k < 20; k++) {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        }
+
+        Kernel makeKernel(MipFilter filter) {
+            if (filter == MipFilter::Box)
+                return {0, {0.5f, 0.5f}};
+            // sinc at half the source rate, Kaiser window (alpha 4) over 4 source pixels on each side;
+            // output pixel i is centered between source pixels 2i and 2i + 1
+            const double pi = 3.14159265358979323846, alpha = 4.0, radius = 4.0;
+            Kernel kernel{-3, {}};
+            double total = 0.0;
+            for (int k = 0; k < 8; k++) {
+                double distance = (kernel.first + k) - 0.5;
+                double x = pi * distance / 2.0;
+                double sinc = std::sin(x) / x;
+                double t = distance / radius;
+                double window = besselI0(alpha * std::sqrt(std::max(0.0, 1.0 - t * t))) / besselI0(alpha);
+                kernel.weights.push_back((float) (sinc * window));
+                total += sinc * window;
+            }
+            for (float &weight : kernel.weights)
+                weight = (float) (weight / total);
+            return kernel;
+        }
+
+        const std::vector<float> &srgbToLinear() {
+            static const std::vector<float> table = [] {
+                std::vector<float> table(256);
+                for (int i = 0; i < 256; i++) {
+                    double c = i / 255.0;
+                    table[i] = (float) (c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+                }
+                return table;
+            }();
+            return table;
+        }
+
+        unsigned char linearToSrgb(float value) {
+            static const int SIZE = 4096;
+            static const std::vector<unsigned char> table = [] {
+                std::vector<unsigned char> table(SIZE);
+                for (int i = 0; i < SIZE; i++) {
+                    double c = (double) i / (SIZE - 1);
+                    c = c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+                    table[i] = (unsigned char) std::lround(c * 255.0);
+                }
+                return table;
+            }();
+            int index = (int) (std::min(1.0f, std::max(0.0f, value)) * (SIZE - 1) + 0.5f);
+            return table[index];
+        }
+
+        // gray+alpha and RGBA images keep alpha in their last channel; it is never gamma encoded
+        bool isColorChannel(int channel, int channels) {
+            return channels == 1 || channels == 3 || channel < channels - 1;
+        }
+
+        void decodeRow(const Image &image, int y, const MipOptions &options, float *out) {
+            const std::vector<float> &linear = srgbToLinear();
+            const unsigned char *in = &image.pixels[(size_t) y * image.width * image.channels];
+            bool normals = options.normalMap && image.channels >= 3;
+            for (int x = 0; x < image.width; x++, in += image.channels, out += 4) {
+                for (int c = 0; c < 4; c++) {
+                    if (c >= image.channels)
+                        out[c] = 0.0f;
+                    else if (normals && c < 3)
+                        out[c] = in[c] / 127.5f - 1.0f;
+                    else if (options.srgb && isColorChannel(c, image.channels))
+                        out[c] = linear[in[c]];
+                    else
+                        out[c] = in[c] / 255.0f;
+                }
+            }
+        }
+
+        void encodeRow(float *in, int width, int channels, const MipOptions &options, unsigned char *out) {
+            bool normals = options.normalMap && channels >= 3;
+            for (int x = 0; x < width; x++, in += 4, out += channels) {
+                if (normals) {
+                    float length = std::sqrt(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+                    if (length > 1e-6f)
+                        for (int c = 0; c < 3; c++)
+                            in[c] /= length;
+                }
+                for (int c = 0; c < channels; c++) {
+                    if (normals && c < 3)
+                        out[c] = (unsigned char) std::lround(std::min(1.0f, std::max(-1.0f, in[c])) * 127.5f + 127.5f);
+                    else if (options.srgb && isColorChannel(c, channels))
+                        out[c] = linearToSrgb(in[c]);
+                    else
+                        out[c] = (unsigned char) std::lround(std::min(1.0f, std::max(0.0f, in[c])) * 255.0f);
+                }
+            }
+        }
+
+        int sampleIndex(int i, int size, bool wrap) {
+            if (wrap)
+                return ((i % size) + size) % size;
+            return std::min(std::max(i, 0), size - 1);
+        }
+
+        // out += weight * in for one pixel
+        void accumulatePixel(float *out, const float *in, float weight) {
+#if defined(__SSE__)
+            _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out), _mm_mul_ps(_mm_set1_ps(weight), _mm_loadu_ps(in))));
+#else
+            for (int c = 0; c < 4; c++)
+                out[c] += weight * in[c];
+#endif
+        }
+
+        // out += weight * in for count floats (a multiple of 4)
+        void accumulateRow(float *out, const float *in, float weight, size_t count) {
+            size_t i = 0;
+#if defined(__AVX__)
+            __m256 w8 = _mm256_set1_ps(weight);
+            for (; i + 8 <= count; i += 8)
+                _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(w8, _mm256_loadu_ps(in + i))));
+#endif
+            for (; i < count; i += 4)
+                accumulatePixel(out + i, in + i, weight);
+        }
+
+        // halves a width x height image, row(y) returns row y as 4 floats per pixel.
+        // horizontal pass first, then the vertical one over whole rows
+        template<typename RowSource>
+        FloatImage downsample(int width, int height, RowSource row, const Kernel &kernel, bool wrap) {
+            int outWidth = std::max(1, width / 2), outHeight = std::max(1, height / 2);
+            int taps = (int) kernel.weights.size();
+
+            FloatImage horizontal(outWidth, height);
+            for (int y = 0; y < height; y++) {
+                const float *in = row(y);
+                float *out = horizontal.row(y);
+                if (width == 1) {
+                    std::copy(in, in + 4, out);
+                    continue;
+                }
+                for (int x = 0; x < outWidth; x++)
+                    for (int k = 0; k < taps; k++)
+                        accumulatePixel(out + x * 4, in + sampleIndex(2 * x + kernel.first + k, width, wrap) * 4,
+                                        kernel.weights[k]);
+            }
+            if (height == 1)
+                return horizontal;
+
+            FloatImage result(outWidth, outHeight);
+            for (int y = 0; y < outHeight; y++)
+                for (int k = 0; k < taps; k++)
+                    accumulateRow(result.row(y), horizontal.row(sampleIndex(2 * y + kernel.first + k, height, wrap)),
+                                  kernel.weights[k], (size_t) outWidth * 4);
+            return result;
+        }
+
+        Image encode(FloatImage &image, int channels, const MipOptions &options) {
+            Image result;
+            result.width = image.width;
+            result.height = image.height;
+            result.channels = channels;
+            result.pixels.resize((size_t) image.width * image.height * channels);
+            for (int y = 0; y < image.height; y++)
+                encodeRow(image.row(y), image.width, channels, options, &result.pixels[(size_t) y * image.width * channels]);
+            return result;
+        }
+    }
+
+    // base followed by every smaller level down to 1x1. each level is filtered from the float
+    // version of the one above it, so rounding doesn't accumulate down the chain
+    std::vector<Image> buildMipChain(Image base, const MipOptions &options = MipOptions()) {
+        std::vector<Image> levels;
+        if (base.width <= 1 && base.height <= 1) {
+            levels.push_back(std::move(base));
+            return levels;
+        }
+        detail::Kernel kernel = detail::makeKernel(options.filter);
+        int channels = base.channels;
+
+        std::vector<float> scratch((size_t) base.width * 4);
+        detail::FloatImage current = detail::downsample(base.width, base.height, [&](int y) {
+            detail::decodeRow(base, y, options, scratch.data());
+            return (const float *) scratch.data();
+        }, kernel, options.wrap);
+        levels.push_back(std::move(base));
+
+        while (true) {
+            // encode renormalizes normals in place, which is what the next level should start from too
+            levels.push_back(detail::encode(current, channels, options));
+            if (current.width == 1 && current.height == 1)
+                break;
+            current = detail::downsample(current.width, current.height, [&](int y) {
+                return (const float *) current.row(y);
+            }, kernel, options.wrap);
+        }
+        return levels;
+    }
+
+    // image scaled to width x height. it is halved with a 2x2 box first for as long as it is at least twice the
+    // target, so large reductions don't skip texels, then resampled bilinearly (in the stored encoding)
+    Image resizeImage(Image image, int width, int height) {
+        int channels = image.channels;
+        while (image.width >= 2 * width && image.height >= 2 * height) {
+            Image half;
+            half.width = image.width / 2;
+            half.height = image.height / 2;
+            half.channels = channels;
+            half.pixels.resize((size_t) half.width * half.height * channels);
+            size_t stride = (size_t) image.width * channels;
+            for (int y = 0; y < half.height; y++) {
+                const unsigned char *top = &image.pixels[2 * y * stride], *bottom = top + stride;
+                unsigned char *out = &half.pixels[(size_t) y * half.width * channels];
+                for (int x = 0; x < half.width * channels; x++) {
+                    int i = (x / channels) * 2 * channels + x % channels;
+                    out[x] = (unsigned char) ((top[i] + top[i + channels] + bottom[i] + bottom[i + channels] + 2) / 4);
+                }
+            }
+            image = std::move(half);
+        }
+        if (image.width == width && image.height == height)
+            return image;
+
+        Image result;
+        result.width = width;
+        result.height = height;
+        result.channels = channels;
+        result.pixels.resize((size_t) width * height * channels);
+        auto source = [](int i, int size, int sourceSize, int &first, float &fraction) {
+            float position = std::min(std::max((i + 0.5f) * sourceSize / size - 0.5f, 0.0f), sourceSize - 1.0f);
+            first = std::min((int) position, sourceSize - 2 < 0 ? 0 : sourceSize - 2);
+            fraction = sourceSize > 1 ? position - first : 0.0f;
+        };
+        for (int y = 0; y < height; y++) {
+            int y0;
+            float fy;
+            source(y, height, image.height, y0, fy);
+            const unsigned char *row0 = &image.pixels[(size_t) y0 * image.width * channels];
+            const unsigned char *row1 = image.height > 1 ? row0 + (size_t) image.width * channels : row0;
+            for (int x = 0; x < width; x++) {
+                int x0;
+                float fx;
+                source(x, width, image.width, x0, fx);
+                int x1 = image.width > 1 ? x0 + 1 : x0;
+                for (int c = 0; c < channels; c++) {
+                    float top = row0[x0 * channels + c] + (row0[x1 * channels + c] - row0[x0 * channels + c]) * fx;
+                    float bottom = row1[x0 * channels + c] + (row1[x1 * channels + c] - row1[x0 * channels + c]) * fx;
+                    result.pixels[((size_t) y * width + x) * channels + c] = (unsigned char) (top + (bottom - top) * fy + 0.5f);
+                }
+            }
+        }
+        return result;
+    }
+
+};
+
+#endif //PROJECT_BASE_MIPCHAIN_H
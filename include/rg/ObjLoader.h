@@ -0,0 +1,669 @@
+#ifndef PROJECT_BASE_OBJLOADER_H
+#define PROJECT_BASE_OBJLOADER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <rg/DiskCache.h>
+#include <rg/AssetArchive.h>
+#include <rg/ThreadPool.h>
+
+// Wavefront OBJ/MTL importer producing the same MeshData Model::processMesh builds from ASSIMP with
+// Model::importFlags (triangulate, smooth normals, flipped UVs, tangent space), without going through ASSIMP.
+// The file is memory mapped and cut into chunks at line ends; the chunks are parsed on the thread pool in two
+// passes: the first counts the v/vt/vn lines, so the second knows where each chunk's attributes go and can
+// resolve relative (negative) indices right away. Meshes are then put together the way ASSIMP's OBJ importer
+// splits them: a new mesh at every group, object or material change.
+//   per corner vertices, polygons fanned into triangles (quads from their concave corner, like ASSIMP)
+//   normals from the file, or if a mesh has none the average of the face normals at each position
+//   tangents per triangle, then averaged between vertices at the same position with the same normal
+//   material textures: map_Kd diffuse, map_Ks specular, map_bump/bump normal, map_Ka height
+namespace rg {
+
+    namespace detail {
+
+        // 0 based, -1 when the corner doesn't reference one
+        struct Corner {
+            int position;
+            int texCoord;
+            int normal;
+        };
+
+        // usemtl, g, o and mtllib lines, in order with the faces around them
+        struct Statement {
+            enum Kind {
+                Material, Group, Library
+            };
+            Kind kind;
+            size_t face; // faces of the chunk before this statement
+            std::string name;
+        };
+
+        struct Chunk {
+            const char *begin;
+            const char *end;
+            size_t numPositions = 0, numTexCoords = 0, numNormals = 0;
+            size_t positionBase = 0, texCoordBase = 0, normalBase = 0;
+            std::vector<Corner> corners;
+            std::vector<uint32_t> faceStarts; // first corner of every face, plus one past the last
+            std::vector<Statement> statements;
+            std::string error;
+        };
+
+        // faces [firstFace, firstFace + numFaces) of one chunk
+        struct Segment {
+            size_t chunk;
+            size_t firstFace;
+            size_t numFaces;
+            size_t firstVertex;
+            size_t firstIndex;
+        };
+
+        struct MeshPlan {
+            std::string material;
+            std::vector<Segment> segments;
+            size_t numVertices = 0;
+            size_t numIndices = 0;
+            bool hasTexCoords = false;
+            bool hasNormals = false;
+        };
+
+        struct Material {
+            std::string diffuse, specular, bump, ambient;
+        };
+
+        bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+        const char *skipSpaces(const char *p, const char *end) {
+            while (p < end && isSpace(*p))
+                p++;
+            return p;
+        }
+
+        const char *skipWord(const char *p, const char *end) {
+            while (p < end && !isSpace(*p))
+                p++;
+            return p;
+        }
+
+        // rest of the line without surrounding white space
+        std::string restOfLine(const char *p, const char *end) {
+            p = skipSpaces(p, end);
+            while (end > p && isSpace(end[-1]))
+                end--;
+            return std::string(p, end);
+        }
+
+        bool keyword(const char *p, const char *end, const char *word) {
+            size_t length = strlen(word);
+            return (size_t) (end - p) >= length && memcmp(p, word, length) == 0 && (p + length == end || isSpace(p[length]));
+        }
+
+        // decimal float with optional sign, fraction and exponent. the digits are collected as an integer and
+        // scaled by one exact power of ten in double, which is as precise as the text for up to 19 digits
+        const char *parseFloat(const char *p, const char *end, float &out) {
+            static const double POWERS[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+            p = skipSpaces(p, end);
+            bool negative = false;
+            if (p < end && (*p == '-' || *p == '+'))
+                negative = *p++ == '-';
+            uint64_t mantissa = 0;
+            int digits = 0, exponent = 0;
+            const char *start = p;
+            for (; p < end && *p >= '0' && *p <= '9'; p++) {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+                    digits += mantissa != 0;
+                } else
+                    exponent++;
+            }
+            if (p < end && *p == '.') {
+                for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+                    if (digits < 19) {
+                        mantissa = mantissa * 10 + (uint64_t) (*p - '0');
+                        digits += mantissa != 0;
+                        exponent--;
+                    }
+                }
+            }
+            if (p == start) {
+                out = 0.0f;
+                return p;
+            }
+            if (p < end && (*p == 'e' || *p == 'E')) {
+                const char *e = p + 1;
+                bool negativeExponent = false;
+                if (e < end && (*e == '-' || *e == '+'))
+                    negativeExponent = *e++ == '-';
+                int value = 0;
+                if (e < end && *e >= '0' && *e <= '9') {
+                    for (; e < end && *e >= '0' && *e <= '9'; e++)
+                        value = std::min(value * 10 + (*e - '0'), 1000);
+                    exponent += negativeExponent ? -value : value;
+                    p = e;
+                }
+            }
+            double value = (double) mantissa;
+            while (exponent > 22) {
+                value *= 1e22;
+                exponent -= 22;
+            }
+            while (exponent < -22) {
+                value /= 1e22;
+                exponent += 22;
+            }
+            value = exponent >= 0 ? value * POWERS[exponent] : value / POWERS[-exponent];
+            out = (float) (negative ? -value : value);
+            return p;
+        }
+
+        const char *parseInt(const char *p, const char *end, long &out) {
+            bool negative = false;
+            if (p < end && (*p == '-' || *p == '+'))
+                negative = *p++ == '-';
+            long value = 0;
+            for (; p < end && *p >= '0' && *p <= '9'; p++)
+                value = value * 10 + (*p - '0');
+            out = negative ? -value : value;
+            return p;
+        }
+
+        // OBJ indices are 1 based, negative ones count back from the last element defined so far
+        bool resolveIndex(long index, size_t defined, int &out) {
+            if (index > 0 && (size_t) index <= defined)
+                out = (int) (index - 1);
+            else if (index < 0 && (size_t) -index <= defined)
+                out = (int) ((long) defined + index);
+            else
+                return false;
+            return true;
+        }
+
+        template<typename LineHandler>
+        void forEachLine(const char *begin, const char *end, LineHandler handle) {
+            const char *line = begin;
+            while (line < end) {
+                const char *lineEnd = (const char *) memchr(line, '\n', (size_t) (end - line));
+                if (!lineEnd)
+                    lineEnd = end;
+                const char *p = skipSpaces(line, lineEnd);
+                if (p < lineEnd && *p != '#' && !handle(p, lineEnd))
+                    return;
+                line = lineEnd + 1;
+            }
+        }
+
+        void countAttributes(Chunk &chunk) {
+            forEachLine(chunk.begin, chunk.end, [&chunk](const char *p, const char *end) {
+                if (end - p > 1 && p[0] == 'v') {
+                    if (isSpace(p[1]))
+                        chunk.numPositions++;
+                    else if (p[1] == 't' && end - p > 2 && isSpace(p[2]))
+                        chunk.numTexCoords++;
+                    else if (p[1] == 'n' && end - p > 2 && isSpace(p[2]))
+                        chunk.numNormals++;
+                }
+                return true;
+            });
+        }
+
+        void parseChunk(Chunk &chunk, std::vector<glm::vec3> &positions, std::vector<glm::vec2> &texCoords,
+                        std::vector<glm::vec3> &normals) {
+            size_t position = chunk.positionBase, texCoord = chunk.texCoordBase, normal = chunk.normalBase;
+            chunk.faceStarts.push_back(0);
+            forEachLine(chunk.begin, chunk.end, [&](const char *p, const char *end) {
+                if (keyword(p, end, "v")) {
+                    glm::vec3 &v = positions[position++];
+                    p = parseFloat(p + 1, end, v.x);
+                    p = parseFloat(p, end, v.y);
+                    parseFloat(p, end, v.z);
+                } else if (keyword(p, end, "vt")) {
+                    glm::vec2 &vt = texCoords[texCoord++];
+                    p = parseFloat(p + 2, end, vt.x);
+                    parseFloat(p, end, vt.y);
+                } else if (keyword(p, end, "vn")) {
+                    glm::vec3 &vn = normals[normal++];
+                    p = parseFloat(p + 2, end, vn.x);
+                    p = parseFloat(p, end, vn.y);
+                    parseFloat(p, end, vn.z);
+                } else if (keyword(p, end, "f")) {
+                    for (p = skipSpaces(p + 1, end); p < end; p = skipSpaces(p, end)) {
+                        Corner corner{-1, -1, -1};
+                        long index = 0;
+                        p = parseInt(p, end, index);
+                        bool ok = resolveIndex(index, position, corner.position);
+                        if (ok && p < end && *p == '/') {
+                            p++;
+                            if (p < end && *p != '/') {
+                                p = parseInt(p, end, index);
+                                ok = resolveIndex(index, texCoord, corner.texCoord);
+                            }
+                            if (ok && p < end && *p == '/') {
+                                p = parseInt(p + 1, end, index);
+                                ok = resolveIndex(index, normal, corner.normal);
+                            }
+                        }
+                        if (!ok || (p < end && !isSpace(*p))) {
+                            chunk.error = "bad face: " + restOfLine(p, end);
+                            return false;
+                        }
+                        chunk.corners.push_back(corner);
+                    }
+                    size_t numCorners = chunk.corners.size() - chunk.faceStarts.back();
+                    if (numCorners < 3) // points and lines aren't drawn
+                        chunk.corners.resize(chunk.faceStarts.back());
+                    else
+                        chunk.faceStarts.push_back((uint32_t) chunk.corners.size());
+                } else if (keyword(p, end, "usemtl")) {
+                    chunk.statements.push_back({Statement::Material, chunk.faceStarts.size() - 1, restOfLine(p + 6, end)});
+                } else if (keyword(p, end, "g") || keyword(p, end, "o")) {
+                    chunk.statements.push_back({Statement::Group, chunk.faceStarts.size() - 1, restOfLine(p + 1, end)});
+                } else if (keyword(p, end, "mtllib")) {
+                    chunk.statements.push_back({Statement::Library, chunk.faceStarts.size() - 1, restOfLine(p + 6, end)});
+                }
+                return true;
+            });
+        }
+
+        // texture statements may carry options (-bm 0.5, -o u v w, ...) before the file name
+        std::string textureName(const char *p, const char *end) {
+            static const std::map<std::string, int> OPTION_ARGUMENTS = {
+                    {"-blendu", 1}, {"-blendv", 1}, {"-boost", 1}, {"-cc", 1}, {"-clamp", 1}, {"-imfchan", 1},
+                    {"-texres", 1}, {"-bm", 1}, {"-type", 1}, {"-mm", 2}, {"-o", 3}, {"-s", 3}, {"-t", 3}};
+            for (p = skipSpaces(p, end); p < end && *p == '-'; p = skipSpaces(p, end)) {
+                const char *optionEnd = skipWord(p, end);
+                auto option = OPTION_ARGUMENTS.find(std::string(p, optionEnd));
+                int arguments = option == OPTION_ARGUMENTS.end() ? 0 : option->second;
+                p = optionEnd;
+                for (int i = 0; i < arguments; i++) {
+                    const char *argument = skipSpaces(p, end);
+                    // -o, -s and -t take up to three numbers
+                    if (arguments == 3 && i > 0 && (argument == end || !(isdigit((unsigned char) *argument) || *argument == '-' || *argument == '.')))
+                        break;
+                    p = skipWord(argument, end);
+                }
+            }
+            return restOfLine(p, end);
+        }
+
+        // keyword comparison is case insensitive, as in ASSIMP (map_Bump == map_bump)
+        bool textureKeyword(const char *p, const char *end, const char *word) {
+            size_t length = strlen(word);
+            if ((size_t) (end - p) < length || (p + length < end && !isSpace(p[length])))
+                return false;
+            for (size_t i = 0; i < length; i++)
+                if (tolower((unsigned char) p[i]) != tolower((unsigned char) word[i]))
+                    return false;
+            return true;
+        }
+
+        void parseMaterials(const std::string &path, std::map<std::string, Material> &materials) {
+            AssetFile file;
+            if (!file.open(path)) {
+                std::cout << "ERROR::OBJ_LOADER:: could not open material library " << path << std::endl;
+                return;
+            }
+            Material *current = nullptr;
+            const char *begin = (const char *) file.data();
+            forEachLine(begin, begin + file.size(), [&](const char *p, const char *end) {
+                const char *wordEnd = skipWord(p, end);
+                if (keyword(p, end, "newmtl"))
+                    current = &materials[restOfLine(p + 6, end)];
+                else if (!current)
+                    return true;
+                else if (textureKeyword(p, end, "map_Kd"))
+                    current->diffuse = textureName(wordEnd, end);
+                else if (textureKeyword(p, end, "map_Ks"))
+                    current->specular = textureName(wordEnd, end);
+                else if (textureKeyword(p, end, "map_Ka"))
+                    current->ambient = textureName(wordEnd, end);
+                else if (textureKeyword(p, end, "map_bump") || textureKeyword(p, end, "bump"))
+                    current->bump = textureName(wordEnd, end); // the last one wins, like in ASSIMP
+                return true;
+            });
+        }
+
+        void pushTexture(std::vector<Texture> &textures, const std::string &path, const char *type) {
+            if (path.empty())
+                return;
+            Texture texture;
+            texture.type = type;
+            texture.path = path;
+            textures.push_back(texture);
+        }
+
+        // corner vertices of one segment, fanned into triangles. quads start at their concave corner if they have one
+        void buildSegment(const Chunk &chunk, const Segment &segment, const MeshPlan &plan,
+                          const std::vector<glm::vec3> &positions, const std::vector<glm::vec2> &texCoords,
+                          const std::vector<glm::vec3> &normals, MeshData &mesh) {
+            const float PI = 3.14159265358979f;
+            Vertex *vertex = &mesh.vertices[segment.firstVertex];
+            unsigned int *index = &mesh.indices[segment.firstIndex];
+            unsigned int base = (unsigned int) segment.firstVertex;
+            for (size_t f = segment.firstFace; f < segment.firstFace + segment.numFaces; f++) {
+                uint32_t first = chunk.faceStarts[f], count = chunk.faceStarts[f + 1] - first;
+                for (uint32_t c = 0; c < count; c++, vertex++) {
+                    const Corner &corner = chunk.corners[first + c];
+                    vertex->Position = positions[corner.position];
+                    vertex->Normal = plan.hasNormals && corner.normal >= 0 ? normals[corner.normal] : glm::vec3(0.0f);
+                    vertex->TexCoords = glm::vec2(0.0f);
+                    if (plan.hasTexCoords && corner.texCoord >= 0)
+                        vertex->TexCoords = glm::vec2(texCoords[corner.texCoord].x, 1.0f - texCoords[corner.texCoord].y);
+                    vertex->Tangent = vertex->Bitangent = glm::vec3(0.0f);
+                }
+
+                unsigned int start = 0;
+                if (count == 4) {
+                    const Vertex *quad = vertex - 4;
+                    for (unsigned int i = 0; i < 4; i++) {
+                        glm::vec3 v = quad[i].Position;
+                        glm::vec3 left = quad[(i + 3) % 4].Position - v, diagonal = quad[(i + 2) % 4].Position - v,
+                                right = quad[(i + 1) % 4].Position - v;
+                        float lengths = glm::length(left) * glm::length(diagonal) * glm::length(right);
+                        if (lengths <= 0.0f)
+                            continue;
+                        left = glm::normalize(left);
+                        diagonal = glm::normalize(diagonal);
+                        right = glm::normalize(right);
+                        float angle = std::acos(std::max(-1.0f, std::min(1.0f, glm::dot(left, diagonal))))
+                                      + std::acos(std::max(-1.0f, std::min(1.0f, glm::dot(right, diagonal))));
+                        if (angle > PI) {
+                            start = i;
+                            break;
+                        }
+                    }
+                }
+                for (uint32_t c = 1; c + 1 < count; c++) {
+                    *index++ = base + start;
+                    *index++ = base + (start + c) % count;
+                    *index++ = base + (start + c + 1) % count;
+                }
+                base += count;
+            }
+        }
+
+        // vertices grouped by identical position, each group in vertex order
+        std::vector<unsigned int> sortByPosition(const std::vector<Vertex> &vertices) {
+            std::vector<unsigned int> order(vertices.size());
+            for (size_t i = 0; i < order.size(); i++)
+                order[i] = (unsigned int) i;
+            std::sort(order.begin(), order.end(), [&vertices](unsigned int a, unsigned int b) {
+                const glm::vec3 &p = vertices[a].Position, &q = vertices[b].Position;
+                if (p.x != q.x)
+                    return p.x < q.x;
+                if (p.y != q.y)
+                    return p.y < q.y;
+                if (p.z != q.z)
+                    return p.z < q.z;
+                return a < b;
+            });
+            return order;
+        }
+
+        template<typename GroupHandler>
+        void forEachPositionGroup(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &order,
+                                  GroupHandler handle) {
+            for (size_t begin = 0, end; begin < order.size(); begin = end) {
+                for (end = begin + 1; end < order.size() && vertices[order[end]].Position == vertices[order[begin]].Position; end++);
+                handle(&order[begin], end - begin);
+            }
+        }
+
+        glm::vec3 normalizeSafe(const glm::vec3 &v) {
+            float length = glm::length(v);
+            return length > 0.0f ? v / length : v;
+        }
+
+        // GenSmoothNormals: face normals averaged over every vertex at the same position
+        void generateNormals(MeshData &mesh, const std::vector<unsigned int> &order) {
+            std::vector<Vertex> &vertices = mesh.vertices;
+            for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+                const unsigned int *triangle = &mesh.indices[t];
+                glm::vec3 normal = normalizeSafe(glm::cross(vertices[triangle[1]].Position - vertices[triangle[0]].Position,
+                                                            vertices[triangle[2]].Position - vertices[triangle[0]].Position));
+                for (int corner = 0; corner < 3; corner++)
+                    vertices[triangle[corner]].Normal = normal;
+            }
+            forEachPositionGroup(vertices, order, [&vertices](const unsigned int *group, size_t size) {
+                glm::vec3 sum(0.0f);
+                for (size_t i = 0; i < size; i++)
+                    sum += vertices[group[i]].Normal;
+                sum = normalizeSafe(sum);
+                for (size_t i = 0; i < size; i++)
+                    vertices[group[i]].Normal = sum;
+            });
+        }
+
+        bool isSpecial(const glm::vec3 &v) {
+            return !std::isfinite(v.x) || !std::isfinite(v.y) || !std::isfinite(v.z);
+        }
+
+        // CalcTangentSpace: per triangle from the UV gradients, projected onto each vertex normal, then averaged
+        // between vertices at the same position whose normals match and whose tangents are within 45 degrees
+        void generateTangents(MeshData &mesh, const std::vector<unsigned int> &order) {
+            std::vector<Vertex> &vertices = mesh.vertices;
+            for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+                const unsigned int *triangle = &mesh.indices[t];
+                const Vertex &p0 = vertices[triangle[0]], &p1 = vertices[triangle[1]], &p2 = vertices[triangle[2]];
+                glm::vec3 v = p1.Position - p0.Position, w = p2.Position - p0.Position;
+                float sx = p1.TexCoords.x - p0.TexCoords.x, sy = p1.TexCoords.y - p0.TexCoords.y;
+                float tx = p2.TexCoords.x - p0.TexCoords.x, ty = p2.TexCoords.y - p0.TexCoords.y;
+                float direction = (tx * sy - ty * sx) < 0.0f ? -1.0f : 1.0f;
+                // all three at the same UV: use the default UV directions
+                if (sx * ty == sy * tx) {
+                    sx = 0.0f;
+                    sy = 1.0f;
+                    tx = 1.0f;
+                    ty = 0.0f;
+                }
+                glm::vec3 tangent = (w * sy - v * ty) * direction;
+                glm::vec3 bitangent = (w * sx - v * tx) * direction;
+                for (int corner = 0; corner < 3; corner++) {
+                    Vertex &vertex = vertices[triangle[corner]];
+                    const glm::vec3 &n = vertex.Normal;
+                    glm::vec3 localTangent = normalizeSafe(tangent - n * glm::dot(tangent, n));
+                    glm::vec3 localBitangent = normalizeSafe(bitangent - n * glm::dot(bitangent, n));
+                    bool invalidTangent = isSpecial(localTangent), invalidBitangent = isSpecial(localBitangent);
+                    if (invalidTangent && !invalidBitangent)
+                        localTangent = normalizeSafe(glm::cross(n, localBitangent));
+                    else if (invalidBitangent && !invalidTangent)
+                        localBitangent = normalizeSafe(glm::cross(localTangent, n));
+                    vertex.Tangent = localTangent;
+                    vertex.Bitangent = localBitangent;
+                }
+            }
+
+            const float ANGLE_EPSILON = 0.9999f, LIMIT = std::cos(glm::radians(45.0f));
+            std::vector<bool> done(vertices.size(), false);
+            std::vector<unsigned int> smoothed;
+            forEachPositionGroup(vertices, order, [&](const unsigned int *group, size_t size) {
+                for (size_t a = 0; a < size; a++) {
+                    const Vertex &origin = vertices[group[a]];
+                    if (done[group[a]])
+                        continue;
+                    // the vertex itself is found again in the group, so it counts twice (as in ASSIMP)
+                    smoothed.assign(1, group[a]);
+                    for (size_t b = 0; b < size; b++) {
+                        const Vertex &other = vertices[group[b]];
+                        if (done[group[b]] || glm::dot(other.Normal, origin.Normal) < ANGLE_EPSILON
+                            || glm::dot(other.Tangent, origin.Tangent) < LIMIT
+                            || glm::dot(other.Bitangent, origin.Bitangent) < LIMIT)
+                            continue;
+                        smoothed.push_back(group[b]);
+                        done[group[b]] = true;
+                    }
+                    glm::vec3 tangent(0.0f), bitangent(0.0f);
+                    for (unsigned int v : smoothed) {
+                        tangent += vertices[v].Tangent;
+                        bitangent += vertices[v].Bitangent;
+                    }
+                    tangent = normalizeSafe(tangent);
+                    bitangent = normalizeSafe(bitangent);
+                    for (unsigned int v : smoothed) {
+                        vertices[v].Tangent = tangent;
+                        vertices[v].Bitangent = bitangent;
+                    }
+                }
+            });
+        }
+    }
+
+    bool isObjFile(const std::string &path) {
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos)
+            return false;
+        std::string extension = path.substr(dot + 1);
+        for (char &c : extension)
+            c = (char) tolower((unsigned char) c);
+        return extension == "obj";
+    }
+
+    // parses path into meshes (appended), false when the file can't be read or is malformed
+    bool loadObj(const std::string &path, std::vector<MeshData> &meshes, ThreadPool &pool = ThreadPool::global()) {
+        AssetFile file;
+        if (!file.open(path)) {
+            std::cout << "ERROR::OBJ_LOADER:: could not open " << path << std::endl;
+            return false;
+        }
+        const char *begin = (const char *) file.data(), *end = begin + file.size();
+
+        // chunks of at least 64 KB, a few per thread so uneven ones balance out
+        const size_t MIN_CHUNK = 64 * 1024;
+        size_t numChunks = std::max<size_t>(1, std::min<size_t>(pool.size() * 4, file.size() / MIN_CHUNK));
+        std::vector<detail::Chunk> chunks;
+        const char *chunkBegin = begin;
+        for (size_t i = 1; i <= numChunks && chunkBegin < end; i++) {
+            const char *chunkEnd = i == numChunks ? end : begin + file.size() * i / numChunks;
+            if (chunkEnd < chunkBegin)
+                continue;
+            const char *newline = (const char *) memchr(chunkEnd, '\n', (size_t) (end - chunkEnd));
+            chunkEnd = newline ? newline + 1 : end;
+            detail::Chunk chunk;
+            chunk.begin = chunkBegin;
+            chunk.end = chunkEnd;
+            chunks.push_back(std::move(chunk));
+            chunkBegin = chunkEnd;
+        }
+
+        pool.parallelFor(chunks.size(), [&chunks](size_t i) { detail::countAttributes(chunks[i]); });
+        size_t numPositions = 0, numTexCoords = 0, numNormals = 0;
+        for (detail::Chunk &chunk : chunks) {
+            chunk.positionBase = numPositions;
+            chunk.texCoordBase = numTexCoords;
+            chunk.normalBase = numNormals;
+            numPositions += chunk.numPositions;
+            numTexCoords += chunk.numTexCoords;
+            numNormals += chunk.numNormals;
+        }
+        std::vector<glm::vec3> positions(numPositions), normals(numNormals);
+        std::vector<glm::vec2> texCoords(numTexCoords);
+        pool.parallelFor(chunks.size(), [&](size_t i) { detail::parseChunk(chunks[i], positions, texCoords, normals); });
+        for (const detail::Chunk &chunk : chunks)
+            if (!chunk.error.empty()) {
+                std::cout << "ERROR::OBJ_LOADER:: " << path << ": " << chunk.error << std::endl;
+                return false;
+            }
+
+        // meshes in file order; a new one starts at a group or material change once the current one has faces
+        std::string directory = path.substr(0, path.find_last_of('/'));
+        std::map<std::string, detail::Material> materials;
+        std::vector<detail::MeshPlan> plans(1);
+        for (size_t c = 0; c < chunks.size(); c++) {
+            const detail::Chunk &chunk = chunks[c];
+            size_t numFaces = chunk.faceStarts.size() - 1;
+            size_t face = 0, statement = 0;
+            while (face < numFaces || statement < chunk.statements.size()) {
+                size_t next = statement < chunk.statements.size() ? chunk.statements[statement].face : numFaces;
+                if (next > face) {
+                    detail::MeshPlan &plan = plans.back();
+                    detail::Segment segment{c, face, next - face, plan.numVertices, plan.numIndices};
+                    for (size_t f = face; f < next; f++) {
+                        uint32_t first = chunk.faceStarts[f], count = chunk.faceStarts[f + 1] - first;
+                        plan.numVertices += count;
+                        plan.numIndices += (count - 2) * 3;
+                        for (uint32_t i = first; i < first + count; i++) {
+                            plan.hasTexCoords |= chunk.corners[i].texCoord >= 0;
+                            plan.hasNormals |= chunk.corners[i].normal >= 0;
+                        }
+                    }
+                    plan.segments.push_back(segment);
+                    face = next;
+                    continue;
+                }
+                const detail::Statement &s = chunk.statements[statement++];
+                if (s.kind == detail::Statement::Library) {
+                    const char *names = s.name.c_str();
+                    for (const char *p = names; *p; ) {
+                        const char *nameEnd = detail::skipWord(p, names + s.name.size());
+                        detail::parseMaterials(directory + '/' + std::string(p, nameEnd), materials);
+                        p = detail::skipSpaces(nameEnd, names + s.name.size());
+                    }
+                    continue;
+                }
+                if (s.kind == detail::Statement::Material && s.name == plans.back().material)
+                    continue;
+                if (plans.back().numVertices > 0)
+                    plans.emplace_back();
+                if (s.kind == detail::Statement::Material)
+                    plans.back().material = s.name;
+                else if (plans.size() > 1)
+                    plans.back().material = plans[plans.size() - 2].material;
+            }
+        }
+        plans.erase(std::remove_if(plans.begin(), plans.end(), [](const detail::MeshPlan &plan) {
+            return plan.numVertices == 0;
+        }), plans.end());
+
+        size_t firstMesh = meshes.size();
+        meshes.resize(firstMesh + plans.size());
+        std::vector<std::pair<size_t, size_t>> segments; // (plan, segment)
+        for (size_t m = 0; m < plans.size(); m++) {
+            MeshData &mesh = meshes[firstMesh + m];
+            mesh.vertices.resize(plans[m].numVertices);
+            mesh.indices.resize(plans[m].numIndices);
+            for (size_t s = 0; s < plans[m].segments.size(); s++)
+                segments.push_back(std::make_pair(m, s));
+        }
+        pool.parallelFor(segments.size(), [&](size_t i) {
+            const detail::MeshPlan &plan = plans[segments[i].first];
+            const detail::Segment &segment = plan.segments[segments[i].second];
+            detail::buildSegment(chunks[segment.chunk], segment, plan, positions, texCoords, normals,
+                              meshes[firstMesh + segments[i].first]);
+        });
+        pool.parallelFor(plans.size(), [&](size_t m) {
+            MeshData &mesh = meshes[firstMesh + m];
+            std::vector<unsigned int> order = detail::sortByPosition(mesh.vertices);
+            if (!plans[m].hasNormals)
+                detail::generateNormals(mesh, order);
+            if (plans[m].hasTexCoords)
+                detail::generateTangents(mesh, order);
+            mesh.computeBounds();
+        });
+
+        for (size_t m = 0; m < plans.size(); m++) {
+            auto material = materials.find(plans[m].material);
+            if (material == materials.end())
+                continue;
+            std::vector<Texture> &textures = meshes[firstMesh + m].textures;
+            detail::pushTexture(textures, material->second.diffuse, "texture_diffuse");
+            detail::pushTexture(textures, material->second.specular, "texture_specular");
+            detail::pushTexture(textures, material->second.bump, "texture_normal");
+            detail::pushTexture(textures, material->second.ambient, "texture_height");
+        }
+        return true;
+    }
+
+};
+
+#endif //PROJECT_BASE_OBJLOADER_H
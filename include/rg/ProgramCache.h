@@ -0,0 +1,113 @@
+#ifndef PROJECT_BASE_PROGRAMCACHE_H
+#define PROJECT_BASE_PROGRAMCACHE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <rg/DiskCache.h>
+#include <rg/GLExtensions.h>
+
+// Linked shader programs saved with glGetProgramBinary into resources/cache/programs/, so later starts skip
+// compiling and linking. Layout, every block 4 byte aligned:
+//   header   magic, format version
+//   key      hash of the stage sources (defines included) and of the driver that made the binary
+//   binary   driver binary format, byte size, bytes
+// A different key means the entry is stale; a binary the driver rejects anyway (new driver build with the same
+// version string) is recompiled by the caller and overwritten. Disabled when the driver has no binary formats.
+class ProgramCache {
+public:
+    static const uint32_t MAGIC = 0x42504752; // "RGPB"
+    static const uint32_t VERSION = 1;
+
+    // disabled
+    ProgramCache() = default;
+
+    // identity names the entry (the stages' paths and defines), source is everything compiled into the program
+    ProgramCache(const std::string &identity, const std::string &source) {
+        if (!enabled())
+            return;
+        m_Path = rg::cacheFilePath("programs", identity, ".bin");
+        m_Key = rg::fnv1a64(driverString(), rg::fnv1a64(source));
+    }
+
+    static bool enabled() {
+        return rg::glExtensions().ProgramBinary != nullptr;
+    }
+
+    // loads the cached binary into program; false when there is none, it is stale or the driver rejected it
+    bool load(GLuint program) const {
+        if (m_Path.empty())
+            return false;
+        rg::MappedFile file;
+        if (!file.open(m_Path))
+            return false;
+        rg::BinaryReader in(file.data(), file.size());
+        if (in.get<uint32_t>() != MAGIC || in.get<uint32_t>() != VERSION || in.get<uint64_t>() != m_Key)
+            return false;
+        GLenum format = in.get<uint32_t>();
+        uint32_t size = in.get<uint32_t>();
+        const unsigned char *binary = in.getBytes(size);
+        if (!in.ok() || size == 0)
+            return false;
+
+        rg::glExtensions().ProgramBinary(program, format, binary, (GLsizei) size);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        return linked == GL_TRUE;
+    }
+
+    // before glLinkProgram: asks the driver to keep the binary around for store()
+    void prepare(GLuint program) const {
+        if (!m_Path.empty())
+            rg::glExtensions().ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // saves the binary of a successfully linked program
+    void store(GLuint program) const {
+        if (m_Path.empty())
+            return;
+        GLint linked = GL_FALSE, length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (linked != GL_TRUE || length <= 0)
+            return;
+        std::vector<unsigned char> binary((size_t) length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        rg::glExtensions().GetProgramBinary(program, length, &written, &format, binary.data());
+        if (written <= 0)
+            return;
+
+        rg::BinaryWriter out;
+        out.put<uint32_t>(MAGIC);
+        out.put<uint32_t>(VERSION);
+        out.put<uint64_t>(m_Key);
+        out.put<uint32_t>(format);
+        out.put<uint32_t>((uint32_t) written);
+        out.putBytes(binary.data(), (size_t) written);
+        if (!rg::writeFileAtomically(m_Path, out.buffer().data(), out.buffer().size()))
+            std::cout << "ERROR::PROGRAM_CACHE:: could not write " << m_Path << std::endl;
+    }
+
+private:
+    std::string m_Path; // empty: cache disabled
+    uint64_t m_Key = 0;
+
+    // binaries only load on the driver that produced them
+    static const std::string &driverString() {
+        static std::string driver;
+        if (driver.empty()) {
+            for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION}) {
+                const char *value = (const char *) glGetString(name);
+                driver += value ? value : "";
+                driver += '\n';
+            }
+        }
+        return driver;
+    }
+};
+
+#endif //PROJECT_BASE_PROGRAMCACHE_H
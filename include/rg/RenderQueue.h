@@ -0,0 +1,248 @@
+#ifndef PROJECT_BASE_RENDERQUEUE_H
+#define PROJECT_BASE_RENDERQUEUE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <rg/GLState.h>
+
+// The frame's draws, submitted in any order as packets and executed in the order of their 64-bit sort keys:
+//
+//   pass (3 bits) | shader (8) | material (16) | vertex array (16) | depth (21)
+//
+// so all of a pass is drawn before the next one, each program is made current once per pass, the draws of a
+// program are grouped by the textures they bind and then by vertex array, and draws that share all of these go
+// front to back. Keys are radix sorted, 8 bits per pass, skipping the passes in which every key has the same
+// digit. Materials and shaders are numbered in the order they are first seen in a frame; the fields of the key
+// only order the draws, what is bound is compared in full, so a wrapped number never binds the wrong thing.
+namespace rg {
+
+    // what a draw belongs to, the first thing the queue sorts by
+    enum RenderPass {
+        RENDER_PASS_OPAQUE,
+        RENDER_PASS_DECAL,  // on top of the opaque geometry, after it
+        RENDER_PASS_SKY,    // last, with GL_LEQUAL: only where nothing was drawn
+        RENDER_PASS_COUNT
+    };
+
+    // the textures of a draw, texture i on unit i; samplerNames (optional) are the sampler uniforms set to the units.
+    // Equal when they bind the same textures to samplers of the same names, wherever the names are stored
+    struct RenderMaterial {
+        static const unsigned int MAX_TEXTURES = 8;
+
+        unsigned int count = 0;
+        GLenum targets[MAX_TEXTURES];
+        GLuint textures[MAX_TEXTURES];
+        const std::string *samplerNames = nullptr;
+
+        void add(GLenum target, GLuint texture) {
+            if (count == MAX_TEXTURES)
+                return;
+            targets[count] = target;
+            textures[count] = texture;
+            count++;
+        }
+
+        bool operator==(const RenderMaterial &other) const {
+            if (count != other.count || !std::equal(targets, targets + count, other.targets)
+                || !std::equal(textures, textures + count, other.textures))
+                return false;
+            if (samplerNames == other.samplerNames)
+                return true;
+            return samplerNames && other.samplerNames && std::equal(samplerNames, samplerNames + count, other.samplerNames);
+        }
+    };
+
+    // everything one draw call needs besides its material's textures
+    struct DrawPacket {
+        Shader *shader = nullptr;
+        uint32_t material = 0;
+        GLuint vertexArray = 0;
+        GLenum mode = GL_TRIANGLES;
+        // 0 for glDrawArrays, with count vertices from first
+        GLenum indexType = 0;
+        GLsizei count = 0;
+        const void *indices = nullptr;
+        GLint first = 0;
+        // 0 for a draw that isn't instanced
+        GLsizei instances = 0;
+        // set as modelUniform when not null; points at storage that outlives the frame
+        const glm::mat4 *model = nullptr;
+        Shader::Uniform modelUniform;
+        // called right before the draw, with the shader in use and the vertex array bound: per mesh uniforms,
+        // instance attributes pointed at the draw's range (GL 3.3 has no base instance) ...
+        void (*prepare)(Shader &shader, const void *object, const void *data, unsigned int argument) = nullptr;
+        const void *object = nullptr;
+        const void *data = nullptr;
+        unsigned int argument = 0;
+
+        static DrawPacket elements(Shader &shader, uint32_t material, GLuint vertexArray, GLsizei count,
+                                   GLenum indexType, const void *indices) {
+            DrawPacket packet;
+            packet.shader = &shader;
+            packet.material = material;
+            packet.vertexArray = vertexArray;
+            packet.count = count;
+            packet.indexType = indexType;
+            packet.indices = indices;
+            return packet;
+        }
+
+        static DrawPacket arrays(Shader &shader, uint32_t material, GLuint vertexArray, GLint first, GLsizei count) {
+            DrawPacket packet;
+            packet.shader = &shader;
+            packet.material = material;
+            packet.vertexArray = vertexArray;
+            packet.first = first;
+            packet.count = count;
+            return packet;
+        }
+    };
+
+    class RenderQueue {
+    public:
+        // starts a frame; depths are view distances, those past depthRange sort as the farthest
+        void begin(float depthRange) {
+            m_DepthRange = depthRange;
+            m_Packets.clear();
+            m_Keys.clear();
+            m_Materials.clear();
+            m_MaterialHashes.clear();
+            m_Shaders.clear();
+        }
+
+        // the number of material for the frame, the same for equal materials. A frame has few of them, so they are
+        // looked up by scanning their hashes; like the packets they are cleared, not freed, between frames
+        uint32_t material(const RenderMaterial &material) {
+            uint64_t hash = 14695981039346656037ull;
+            auto mix = [&hash](const void *bytes, size_t size) {
+                for (size_t i = 0; i < size; i++)
+                    hash = (hash ^ ((const unsigned char *) bytes)[i]) * 1099511628211ull;
+            };
+            mix(&material.count, sizeof(material.count));
+            mix(material.targets, material.count * sizeof(GLenum));
+            mix(material.textures, material.count * sizeof(GLuint));
+            for (unsigned int i = 0; material.samplerNames && i < material.count; i++)
+                mix(material.samplerNames[i].data(), material.samplerNames[i].size() + 1);
+
+            for (size_t i = 0; i < m_MaterialHashes.size(); i++)
+                if (m_MaterialHashes[i] == hash && m_Materials[i] == material)
+                    return (uint32_t) i;
+            m_Materials.push_back(material);
+            m_MaterialHashes.push_back(hash);
+            return (uint32_t) m_Materials.size() - 1;
+        }
+
+        void submit(RenderPass pass, float depth, const DrawPacket &packet) {
+            uint32_t shader = (uint32_t) (std::find(m_Shaders.begin(), m_Shaders.end(), packet.shader) - m_Shaders.begin());
+            if (shader == m_Shaders.size())
+                m_Shaders.push_back(packet.shader);
+            float normalized = std::min(std::max(depth / m_DepthRange, 0.0f), 1.0f);
+            uint64_t key = (uint64_t) pass << 61
+                           | (uint64_t) (shader & 0xFF) << 53
+                           | (uint64_t) (packet.material & 0xFFFF) << 37
+                           | (uint64_t) (packet.vertexArray & 0xFFFF) << 21
+                           | (uint64_t) (normalized * DEPTH_MAX);
+            m_Keys.push_back(SortKey{key, (uint32_t) m_Packets.size()});
+            m_Packets.push_back(packet);
+        }
+
+        // sorts and draws everything submitted since begin()
+        void execute() {
+            sort();
+            GLState &state = GLState::global();
+            int pass = -1;
+            Shader *shader = nullptr;
+            uint32_t material = 0;
+            for (const SortKey &sortKey : m_Keys) {
+                const DrawPacket &packet = m_Packets[sortKey.packet];
+                int packetPass = (int) (sortKey.key >> 61);
+                if (packetPass != pass) {
+                    state.depthFunc(packetPass == RENDER_PASS_SKY ? GL_LEQUAL : GL_LESS);
+                    pass = packetPass;
+                }
+                if (packet.shader != shader) {
+                    shader = packet.shader;
+                    shader->use();
+                    bindMaterial(*shader, m_Materials[packet.material]);
+                    material = packet.material;
+                } else if (packet.material != material) {
+                    bindMaterial(*shader, m_Materials[packet.material]);
+                    material = packet.material;
+                }
+                state.bindVertexArray(packet.vertexArray);
+                if (packet.model)
+                    shader->setMat4(packet.modelUniform, *packet.model);
+                if (packet.prepare)
+                    packet.prepare(*shader, packet.object, packet.data, packet.argument);
+                draw(packet);
+            }
+            state.depthFunc(GL_LESS);
+        }
+
+        size_t size() const { return m_Packets.size(); }
+
+    private:
+        static const uint64_t DEPTH_MAX = (1u << 21) - 1;
+
+        struct SortKey {
+            uint64_t key;
+            uint32_t packet;
+        };
+
+        float m_DepthRange = 1.0f;
+        std::vector<DrawPacket> m_Packets;
+        std::vector<SortKey> m_Keys, m_Scratch;
+        std::vector<RenderMaterial> m_Materials;
+        std::vector<uint64_t> m_MaterialHashes;
+        std::vector<Shader *> m_Shaders;
+
+        // stable LSD radix sort of m_Keys, so draws with equal keys keep their submission order
+        void sort() {
+            size_t count = m_Keys.size();
+            m_Scratch.resize(count);
+            for (unsigned int shift = 0; shift < 64 && count > 1; shift += 8) {
+                size_t offsets[257] = {0};
+                for (const SortKey &sortKey : m_Keys)
+                    offsets[((sortKey.key >> shift) & 0xFF) + 1]++;
+                if (offsets[((m_Keys[0].key >> shift) & 0xFF) + 1] == count)
+                    continue;
+                for (unsigned int digit = 0; digit < 256; digit++)
+                    offsets[digit + 1] += offsets[digit];
+                for (const SortKey &sortKey : m_Keys)
+                    m_Scratch[offsets[(sortKey.key >> shift) & 0xFF]++] = sortKey;
+                m_Keys.swap(m_Scratch);
+            }
+        }
+
+        static void bindMaterial(Shader &shader, const RenderMaterial &material) {
+            for (unsigned int unit = 0; unit < material.count; unit++) {
+                if (material.samplerNames)
+                    shader.setInt(material.samplerNames[unit], (int) unit);
+                GLState::global().bindTexture(unit, material.targets[unit], material.textures[unit]);
+            }
+        }
+
+        static void draw(const DrawPacket &packet) {
+            if (packet.indexType == 0) {
+                if (packet.instances)
+                    glDrawArraysInstanced(packet.mode, packet.first, packet.count, packet.instances);
+                else
+                    glDrawArrays(packet.mode, packet.first, packet.count);
+            } else if (packet.instances)
+                glDrawElementsInstanced(packet.mode, packet.count, packet.indexType, packet.indices, packet.instances);
+            else
+                glDrawElements(packet.mode, packet.count, packet.indexType, packet.indices);
+        }
+    };
+};
+
+#endif //PROJECT_BASE_RENDERQUEUE_H
@@ -0,0 +1,361 @@
+#ifndef PROJECT_BASE_SCENE_H
+#define PROJECT_BASE_SCENE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <rg/DiskCache.h>
+#include <rg/AssetArchive.h>
+#include <rg/ObjLoader.h>
+
+// Scene description: which models are placed where, the lights and the decals. Written as text
+// (resources/scenes/*.scene), one statement per line, '#' starts a comment:
+//   model <name> <path> [packed] [instanced]
+//   instance <model name> <x> <y> <z> [transform]
+//   decal <texture path> <x> <y> <z> [transform] [rect <u0> <v0> <u1> <v1>]
+//   light <x> <y> <z> ambient <r g b> diffuse <r g b> specular <r g b> attenuation <constant linear quadratic>
+// where [transform] is any sequence of "rotate <degrees> <axis x y z>" and "scale <s>" / "scale <x y z>",
+// applied after the translation in the order written.
+// The text is compiled once into resources/cache/scenes/ and every later load maps the compiled form: the
+// instance matrices are stored grouped by model, ready to go into an instance buffer as they are.
+// Layout, every block 4 byte aligned:
+//   header     magic, format version
+//   source     exists, size, mtime of the scene file
+//   models     count, per model {name, path, flags, first instance, instance count}
+//   textures   count, decal texture paths
+//   lights     count, SceneLight array
+//   decals     count, SceneDecal array
+//   instances  count, mat4 array
+namespace rg {
+
+    enum SceneModelFlags : uint32_t {
+        SCENE_MODEL_PACKED = 1,   // meshes use VertexFormat::Packed
+        SCENE_MODEL_INSTANCED = 2 // drawn from an instance buffer instead of one draw per instance
+    };
+
+    struct SceneModel {
+        std::string name;
+        std::string path;
+        uint32_t flags = 0;
+        uint32_t firstInstance = 0;
+        uint32_t numInstances = 0;
+    };
+
+    struct SceneLight {
+        glm::vec3 position;
+        glm::vec3 ambient;
+        glm::vec3 diffuse;
+        glm::vec3 specular;
+        float constant;
+        float linear;
+        float quadratic;
+    };
+
+    // a textured unit quad in the xy plane placed by transform; rect is the part of the texture it shows
+    struct SceneDecal {
+        glm::mat4 transform;
+        glm::vec4 rect; // u0 v0 u1 v1
+        uint32_t texture; // index into Scene::decalTextures()
+        uint32_t reserved[3];
+    };
+
+    namespace detail {
+
+        // what the text compiles to
+        struct SceneSource {
+            std::vector<SceneModel> models;
+            std::vector<std::vector<glm::mat4>> instances; // per model
+            std::vector<std::string> textures;
+            std::vector<SceneLight> lights;
+            std::vector<SceneDecal> decals;
+        };
+
+        const char *parseFloats(const char *p, const char *end, float *out, int count) {
+            for (int i = 0; i < count; i++)
+                p = parseFloat(p, end, out[i]);
+            return p;
+        }
+
+        bool startsNumber(const char *p, const char *end) {
+            return p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.');
+        }
+
+        // "<x> <y> <z> [rotate ...] [scale ...]", stops at the first word it doesn't know
+        const char *parseTransform(const char *p, const char *end, glm::mat4 &out) {
+            float position[3];
+            p = parseFloats(p, end, position, 3);
+            out = glm::translate(glm::mat4(1.0f), glm::vec3(position[0], position[1], position[2]));
+            while (true) {
+                p = skipSpaces(p, end);
+                if (keyword(p, end, "rotate")) {
+                    float rotation[4];
+                    p = parseFloats(p + 6, end, rotation, 4);
+                    out = glm::rotate(out, glm::radians(rotation[0]), glm::vec3(rotation[1], rotation[2], rotation[3]));
+                } else if (keyword(p, end, "scale")) {
+                    float scale[3];
+                    p = parseFloat(p + 5, end, scale[0]);
+                    scale[1] = scale[2] = scale[0];
+                    if (startsNumber(skipSpaces(p, end), end))
+                        p = parseFloats(p, end, scale + 1, 2);
+                    out = glm::scale(out, glm::vec3(scale[0], scale[1], scale[2]));
+                } else
+                    return p;
+            }
+        }
+
+        bool parseScene(const std::string &path, SceneSource &scene) {
+            rg::AssetFile file;
+            if (!file.open(path)) {
+                std::cout << "ERROR::SCENE:: could not read " << path << std::endl;
+                return false;
+            }
+            std::map<std::string, uint32_t> modelIndex, textureIndex;
+            bool ok = true;
+            auto fail = [&](const char *p, const char *end, const char *reason) {
+                std::cout << "ERROR::SCENE:: " << path << ": " << reason << ": " << restOfLine(p, end) << std::endl;
+                ok = false;
+            };
+            const char *begin = (const char *) file.data();
+            forEachLine(begin, begin + file.size(), [&](const char *p, const char *end) {
+                const char *line = p;
+                if (keyword(p, end, "model")) {
+                    p = skipSpaces(p + 5, end);
+                    const char *nameEnd = skipWord(p, end);
+                    SceneModel model;
+                    model.name.assign(p, nameEnd);
+                    p = skipSpaces(nameEnd, end);
+                    const char *pathEnd = skipWord(p, end);
+                    model.path.assign(p, pathEnd);
+                    for (p = skipSpaces(pathEnd, end); p < end; p = skipSpaces(skipWord(p, end), end)) {
+                        if (keyword(p, end, "packed"))
+                            model.flags |= SCENE_MODEL_PACKED;
+                        else if (keyword(p, end, "instanced"))
+                            model.flags |= SCENE_MODEL_INSTANCED;
+                        else
+                            fail(line, end, "unknown model option");
+                    }
+                    if (model.name.empty() || model.path.empty() || modelIndex.count(model.name)) {
+                        fail(line, end, "model needs a new name and a path");
+                        return true;
+                    }
+                    modelIndex[model.name] = (uint32_t) scene.models.size();
+                    scene.models.push_back(model);
+                    scene.instances.emplace_back();
+                } else if (keyword(p, end, "instance")) {
+                    p = skipSpaces(p + 8, end);
+                    const char *nameEnd = skipWord(p, end);
+                    auto model = modelIndex.find(std::string(p, nameEnd));
+                    if (model == modelIndex.end()) {
+                        fail(line, end, "instance of an undeclared model");
+                        return true;
+                    }
+                    glm::mat4 transform;
+                    p = skipSpaces(parseTransform(nameEnd, end, transform), end);
+                    if (p < end)
+                        fail(line, end, "unexpected text after the transform");
+                    scene.instances[model->second].push_back(transform);
+                } else if (keyword(p, end, "decal")) {
+                    p = skipSpaces(p + 5, end);
+                    const char *textureEnd = skipWord(p, end);
+                    std::string texture(p, textureEnd);
+                    auto found = textureIndex.find(texture);
+                    if (found == textureIndex.end()) {
+                        found = textureIndex.insert(std::make_pair(texture, (uint32_t) scene.textures.size())).first;
+                        scene.textures.push_back(texture);
+                    }
+                    SceneDecal decal = {};
+                    decal.texture = found->second;
+                    decal.rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+                    p = skipSpaces(parseTransform(textureEnd, end, decal.transform), end);
+                    if (keyword(p, end, "rect"))
+                        p = skipSpaces(parseFloats(p + 4, end, &decal.rect[0], 4), end);
+                    if (p < end)
+                        fail(line, end, "unexpected text after the decal");
+                    scene.decals.push_back(decal);
+                } else if (keyword(p, end, "light")) {
+                    SceneLight light = {};
+                    p = parseFloats(p + 5, end, &light.position[0], 3);
+                    for (p = skipSpaces(p, end); p < end; p = skipSpaces(p, end)) {
+                        if (keyword(p, end, "ambient"))
+                            p = parseFloats(p + 7, end, &light.ambient[0], 3);
+                        else if (keyword(p, end, "diffuse"))
+                            p = parseFloats(p + 7, end, &light.diffuse[0], 3);
+                        else if (keyword(p, end, "specular"))
+                            p = parseFloats(p + 8, end, &light.specular[0], 3);
+                        else if (keyword(p, end, "attenuation")) {
+                            p = parseFloat(p + 11, end, light.constant);
+                            p = parseFloat(p, end, light.linear);
+                            p = parseFloat(p, end, light.quadratic);
+                        } else {
+                            fail(line, end, "unknown light property");
+                            break;
+                        }
+                    }
+                    scene.lights.push_back(light);
+                } else
+                    fail(line, end, "unknown statement");
+                return true;
+            });
+            return ok;
+        }
+    }
+
+    class Scene {
+    public:
+        static const uint32_t MAGIC = 0x43534752; // "RGSC"
+        // bump whenever the compiled layout or the meaning of the text changes
+        static const uint32_t VERSION = 1;
+
+        Scene() = default;
+        Scene(const Scene &) = delete;
+        Scene &operator=(const Scene &) = delete;
+
+        // maps the compiled form of the scene file at path, compiling it first when there is none or it is stale
+        bool load(const std::string &path) {
+            m_Buffer.clear();
+            if (m_File.open(cachePath(path)) && parse(m_File.data(), m_File.size(), path))
+                return true;
+            m_File.close();
+
+            detail::SceneSource source;
+            bool parsed = detail::parseScene(path, source);
+            m_Buffer = compile(path, source);
+            // a scene with errors is used as far as it goes but not cached, so it's parsed (and reported) again on
+            // every start until the file is fixed
+            if (!parsed)
+                std::cout << "ERROR::SCENE:: " << path << " has errors, the statements above were skipped" << std::endl;
+            else if (!rg::writeFileAtomically(cachePath(path), m_Buffer.data(), m_Buffer.size()))
+                std::cout << "ERROR::SCENE:: could not write compiled scene for " << path << std::endl;
+            return parse((const unsigned char *) m_Buffer.data(), m_Buffer.size(), path);
+        }
+
+        const std::vector<SceneModel> &models() const { return m_Models; }
+        // index into models() or -1
+        int findModel(const std::string &name) const {
+            for (size_t i = 0; i < m_Models.size(); i++)
+                if (m_Models[i].name == name)
+                    return (int) i;
+            return -1;
+        }
+
+        // the instance matrices of a model, contiguous; valid as long as the scene
+        const glm::mat4 *instances(const SceneModel &model) const { return m_Instances + model.firstInstance; }
+        const glm::mat4 *instances() const { return m_Instances; }
+        uint32_t numInstances() const { return m_NumInstances; }
+
+        const std::vector<std::string> &decalTextures() const { return m_Textures; }
+        const SceneDecal *decals() const { return m_Decals; }
+        uint32_t numDecals() const { return m_NumDecals; }
+
+        const SceneLight *lights() const { return m_Lights; }
+        uint32_t numLights() const { return m_NumLights; }
+
+        static std::string cachePath(const std::string &path) {
+            return rg::cacheFilePath("scenes", path, ".rgscene");
+        }
+
+        static std::string compile(const std::string &path, const detail::SceneSource &source) {
+            rg::BinaryWriter out;
+            out.put<uint32_t>(MAGIC);
+            out.put<uint32_t>(VERSION);
+            rg::FileSignature signature = rg::assetSignature(path);
+            out.put<uint32_t>(signature.exists);
+            out.put<uint64_t>(signature.size);
+            out.put<int64_t>(signature.mtime);
+
+            out.put<uint32_t>((uint32_t) source.models.size());
+            uint32_t first = 0;
+            for (size_t m = 0; m < source.models.size(); m++) {
+                out.putString(source.models[m].name);
+                out.putString(source.models[m].path);
+                out.put<uint32_t>(source.models[m].flags);
+                out.put<uint32_t>(first);
+                out.put<uint32_t>((uint32_t) source.instances[m].size());
+                first += (uint32_t) source.instances[m].size();
+            }
+            out.put<uint32_t>((uint32_t) source.textures.size());
+            for (const std::string &texture : source.textures)
+                out.putString(texture);
+            out.put<uint32_t>((uint32_t) source.lights.size());
+            out.putBytes(source.lights.data(), source.lights.size() * sizeof(SceneLight));
+            out.put<uint32_t>((uint32_t) source.decals.size());
+            out.putBytes(source.decals.data(), source.decals.size() * sizeof(SceneDecal));
+            out.put<uint32_t>(first);
+            for (const std::vector<glm::mat4> &instances : source.instances)
+                out.putBytes(instances.data(), instances.size() * sizeof(glm::mat4));
+            return out.buffer();
+        }
+
+    private:
+        rg::MappedFile m_File;
+        std::string m_Buffer; // compiled here when it couldn't be mapped
+        std::vector<SceneModel> m_Models;
+        std::vector<std::string> m_Textures;
+        const SceneLight *m_Lights = nullptr;
+        uint32_t m_NumLights = 0;
+        const SceneDecal *m_Decals = nullptr;
+        uint32_t m_NumDecals = 0;
+        const glm::mat4 *m_Instances = nullptr;
+        uint32_t m_NumInstances = 0;
+
+        bool parse(const unsigned char *data, size_t size, const std::string &path) {
+            m_Models.clear();
+            m_Textures.clear();
+            rg::BinaryReader in(data, size);
+            if (in.get<uint32_t>() != MAGIC || in.get<uint32_t>() != VERSION)
+                return reject(path, "format");
+            rg::FileSignature recorded;
+            recorded.exists = in.get<uint32_t>() != 0;
+            recorded.size = in.get<uint64_t>();
+            recorded.mtime = in.get<int64_t>();
+            if (in.ok() && rg::assetSignature(path) != recorded)
+                return reject(path, "scene changed");
+
+            uint32_t numModels = in.get<uint32_t>();
+            for (uint32_t i = 0; i < numModels && in.ok(); i++) {
+                SceneModel model;
+                model.name = in.getString();
+                model.path = in.getString();
+                model.flags = in.get<uint32_t>();
+                model.firstInstance = in.get<uint32_t>();
+                model.numInstances = in.get<uint32_t>();
+                m_Models.push_back(model);
+            }
+            uint32_t numTextures = in.get<uint32_t>();
+            for (uint32_t i = 0; i < numTextures && in.ok(); i++)
+                m_Textures.push_back(in.getString());
+            m_NumLights = in.get<uint32_t>();
+            m_Lights = (const SceneLight *) in.getBytes((size_t) m_NumLights * sizeof(SceneLight));
+            m_NumDecals = in.get<uint32_t>();
+            m_Decals = (const SceneDecal *) in.getBytes((size_t) m_NumDecals * sizeof(SceneDecal));
+            m_NumInstances = in.get<uint32_t>();
+            m_Instances = (const glm::mat4 *) in.getBytes((size_t) m_NumInstances * sizeof(glm::mat4));
+            if (!in.ok())
+                return reject(path, "truncated");
+            for (const SceneModel &model : m_Models)
+                if ((uint64_t) model.firstInstance + model.numInstances > m_NumInstances)
+                    return reject(path, "corrupt");
+            for (uint32_t i = 0; i < m_NumDecals; i++)
+                if (m_Decals[i].texture >= m_Textures.size())
+                    return reject(path, "corrupt");
+            return true;
+        }
+
+        bool reject(const std::string &path, const std::string &reason) {
+            std::cout << "SCENE:: recompiling " << path << " (" << reason << ")" << std::endl;
+            m_Models.clear();
+            m_Textures.clear();
+            m_NumLights = m_NumDecals = m_NumInstances = 0;
+            return false;
+        }
+    };
+};
+
+#endif //PROJECT_BASE_SCENE_H
@@ -0,0 +1,48 @@
+#ifndef PROJECT_BASE_SHADERMANAGER_H
+#define PROJECT_BASE_SHADERMANAGER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <learnopengl/shader.h>
+#include <rg/GLExtensions.h>
+
+// Builds every program of the scene at once: load() only submits the compiles and the link (or loads the cached
+// binary), so the driver works on all of them, on its own threads where GL_KHR_parallel_shader_compile lets it,
+// while the context thread goes on loading assets. Status is checked lazily by poll(), wait() or a shader's first
+// use(). Context thread only.
+class ShaderManager {
+    std::vector<std::unique_ptr<Shader>> m_Shaders;
+public:
+    ShaderManager() {
+        // let the driver use as many compiler threads as it likes
+        if (rg::glExtensions().MaxShaderCompilerThreads)
+            rg::glExtensions().MaxShaderCompilerThreads(0xFFFFFFFFu);
+    }
+    ShaderManager(const ShaderManager &) = delete;
+    ShaderManager &operator=(const ShaderManager &) = delete;
+
+    // the shader stays valid (and in place) as long as the manager
+    Shader &load(const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr,
+                 const std::vector<std::string> &defines = std::vector<std::string>()) {
+        m_Shaders.emplace_back(new Shader(vertexPath, fragmentPath, geometryPath, defines));
+        return *m_Shaders.back();
+    }
+
+    // checks the programs the driver has finished; true once all of them are ready
+    bool poll() {
+        bool all = true;
+        for (const std::unique_ptr<Shader> &shader : m_Shaders)
+            all = shader->ready() && all;
+        return all;
+    }
+
+    // blocks until every program is linked and checked
+    void wait() {
+        for (const std::unique_ptr<Shader> &shader : m_Shaders)
+            shader->finish();
+    }
+};
+
+#endif //PROJECT_BASE_SHADERMANAGER_H
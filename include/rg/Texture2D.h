@@ -5,8 +5,9 @@
 #ifndef PROJECT_BASE_TEXTURE2D_H
 #define PROJECT_BASE_TEXTURE2D_H
 #include <glad/glad.h>
-#include <stb_image.h>
 #include <rg/Error.h>
+#include <rg/TextureRegistry.h>
+#include <rg/GLState.h>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -16,45 +17,37 @@
 #include <iostream>
 
 class Texture2D{
-   unsigned int texture;
+   TextureHandle texture;
 public:
-    Texture2D(std::string path, GLenum sampling, GLenum filtering){
-        glGenTextures(1, &texture);
-        //load image
-        int width, height, nChannel;
-        unsigned char *data = stbi_load(FileSystem::getPath(path).c_str()
-                , &width, &height, &nChannel, 0);
-
-        if(data){
-            std::cout << "Teksura je uspesno ucitana\n";
-            GLenum format;
-            if (nChannel == 1)
-                format = GL_RED;
-            else if (nChannel == 3)
-                format = GL_RGB;
-            else if (nChannel == 4)
-                format = GL_RGBA;
-
-            glBindTexture(GL_TEXTURE_2D, texture);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-
-            //wrap
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : sampling);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : sampling);
-
-            //filter
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filtering);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filtering);
-        }
-        else{
-            ASSERT(false, "Failed to load texture!\n");
-        }
-        stbi_image_free(data);
+    // shared through the TextureRegistry; a new image is decoded on the worker threads and uploaded
+    // by TextureLoader::update(), until then bind() binds the default texture.
+    // filtering: GL_LINEAR or GL_NEAREST, minification blends the mip levels the same way
+    // srgb: color image, its mips are filtered in linear space
+    Texture2D(std::string path, GLenum sampling, GLenum filtering, bool srgb = false){
+        TextureParams params;
+        //wrap
+        params.wrap = sampling;
+        params.clampWithAlpha = true;
+        //filter
+        params.minFilter = filtering == GL_NEAREST ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_LINEAR;
+        params.magFilter = filtering;
+        params.required = true;
+        params.compress = true;
+        params.srgb = srgb;
+        texture = TextureRegistry::global().acquire(FileSystem::getPath(path), params);
     }
 
+    // on the active texture unit
     void bind() {
-        glBindTexture(GL_TEXTURE_2D, texture);
+        rg::GLState::global().bindTexture(GL_TEXTURE_2D, texture->id);
+    }
+
+    void bind(unsigned int unit) {
+        rg::GLState::global().bindTexture(unit, GL_TEXTURE_2D, texture->id);
+    }
+
+    const TextureHandle &handle() const {
+        return texture;
     }
 };
 
@@ -0,0 +1,162 @@
+#ifndef PROJECT_BASE_TEXTURECACHE_H
+#define PROJECT_BASE_TEXTURECACHE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <rg/DiskCache.h>
+#include <rg/AssetArchive.h>
+#include <rg/BlockCompression.h>
+#include <rg/MipChain.h>
+#include <rg/GLExtensions.h>
+
+// Block compressed mip chain of one image, baked into resources/cache/textures/ the first time the image is
+// loaded so later starts upload it with glCompressedTexImage2D without decoding, filtering or encoding anything.
+// Layout, every block 4 byte aligned:
+//   header   magic, format version, block format, channels of the source image
+//   source   exists, size, mtime of the image it was made from
+//   levels   count, then per level {width, height, byte size, blocks}, largest first down to 1x1
+// An entry is rejected (and rebaked by the caller) when the header or the source signature differ.
+class TextureCache {
+public:
+    static const uint32_t MAGIC = 0x58544752; // "RGTX"
+    // bump whenever the encoder or the mip filter change what gets baked
+    static const uint32_t VERSION = 2;
+
+    struct Level {
+        int width;
+        int height;
+        const unsigned char *data; // into the mapping or the freshly baked buffer
+        uint32_t size;
+    };
+
+    TextureCache() = default;
+    TextureCache(const TextureCache &) = delete;
+    TextureCache &operator=(const TextureCache &) = delete;
+
+    // maps the cache entry of sourcePath in the given format; false when there is none or it is stale
+    bool open(const std::string &sourcePath, rg::BlockFormat format, const rg::MipOptions &mipOptions) {
+        m_Buffer.clear();
+        if (!m_File.open(cachePath(sourcePath, format, mipOptions)))
+            return false;
+        return parse(m_File.data(), m_File.size(), sourcePath, format);
+    }
+
+    // builds the mip chain of rgba (width x height, source had channels channels), compresses every level and
+    // writes the cache entry; the result is usable right away even if it couldn't be written
+    bool bake(const std::string &sourcePath, rg::BlockFormat format, const rg::MipOptions &mipOptions,
+              const unsigned char *rgba, int width, int height, int channels) {
+        m_File.close();
+        rg::Image base;
+        base.width = width;
+        base.height = height;
+        base.channels = 4;
+        base.pixels.assign(rgba, rgba + (size_t) width * height * 4);
+        std::vector<rg::Image> chain = rg::buildMipChain(std::move(base), mipOptions);
+
+        rg::BinaryWriter out;
+        out.put<uint32_t>(MAGIC);
+        out.put<uint32_t>(VERSION);
+        out.put<uint32_t>((uint32_t) format);
+        out.put<uint32_t>((uint32_t) channels);
+        rg::FileSignature signature = rg::assetSignature(sourcePath);
+        out.put<uint32_t>(signature.exists);
+        out.put<uint64_t>(signature.size);
+        out.put<int64_t>(signature.mtime);
+        out.put<uint32_t>((uint32_t) chain.size());
+        for (const rg::Image &level : chain) {
+            std::vector<unsigned char> blocks = rg::compressImage(level.pixels.data(), level.width, level.height, format);
+            out.put<uint32_t>((uint32_t) level.width);
+            out.put<uint32_t>((uint32_t) level.height);
+            out.put<uint32_t>((uint32_t) blocks.size());
+            out.putBytes(blocks.data(), blocks.size());
+        }
+        m_Buffer = out.buffer();
+
+        if (!rg::writeFileAtomically(cachePath(sourcePath, format, mipOptions), m_Buffer.data(), m_Buffer.size()))
+            std::cout << "ERROR::TEXTURE_CACHE:: could not write cache for " << sourcePath << std::endl;
+        return parse((const unsigned char *) m_Buffer.data(), m_Buffer.size(), sourcePath, format);
+    }
+
+    rg::BlockFormat format() const { return m_Format; }
+    int channels() const { return m_Channels; }
+    const std::vector<Level> &levels() const { return m_Levels; }
+
+    // bytes of all levels, which sit back to back starting at levels()[0].data
+    size_t dataSize() const {
+        if (m_Levels.empty())
+            return 0;
+        return (size_t) (m_Levels.back().data + m_Levels.back().size - m_Levels.front().data);
+    }
+
+    static GLenum glFormat(rg::BlockFormat format) {
+        switch (format) {
+            case rg::BlockFormat::BC1:
+                return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case rg::BlockFormat::BC3:
+                return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case rg::BlockFormat::BC4:
+                return GL_COMPRESSED_RED_RGTC1;
+            case rg::BlockFormat::BC5:
+                return GL_COMPRESSED_RG_RGTC2;
+        }
+        return GL_NONE;
+    }
+
+    // <image>-<hash>.<mip options>.<format>.rgtex
+    static std::string cachePath(const std::string &sourcePath, rg::BlockFormat format, const rg::MipOptions &mipOptions) {
+        static const char *extensions[] = {".bc1.rgtex", ".bc3.rgtex", ".bc4.rgtex", ".bc5.rgtex"};
+        return rg::cacheFilePath("textures", sourcePath, "." + mipOptions.tag() + extensions[(int) format]);
+    }
+
+private:
+    rg::MappedFile m_File;
+    std::string m_Buffer;
+    rg::BlockFormat m_Format = rg::BlockFormat::BC1;
+    int m_Channels = 0;
+    std::vector<Level> m_Levels;
+
+    bool parse(const unsigned char *data, size_t size, const std::string &sourcePath, rg::BlockFormat format) {
+        m_Levels.clear();
+        rg::BinaryReader in(data, size);
+        if (in.get<uint32_t>() != MAGIC || in.get<uint32_t>() != VERSION || in.get<uint32_t>() != (uint32_t) format)
+            return reject(sourcePath, "format");
+        m_Format = format;
+        m_Channels = (int) in.get<uint32_t>();
+
+        rg::FileSignature recorded;
+        recorded.exists = in.get<uint32_t>() != 0;
+        recorded.size = in.get<uint64_t>();
+        recorded.mtime = in.get<int64_t>();
+        if (in.ok() && rg::assetSignature(sourcePath) != recorded)
+            return reject(sourcePath, "source changed");
+
+        uint32_t numLevels = in.get<uint32_t>();
+        for (uint32_t i = 0; i < numLevels && in.ok(); i++) {
+            Level level;
+            level.width = (int) in.get<uint32_t>();
+            level.height = (int) in.get<uint32_t>();
+            level.size = in.get<uint32_t>();
+            level.data = in.getBytes(level.size);
+            if (level.size != rg::compressedSize(format, level.width, level.height))
+                return reject(sourcePath, "corrupt");
+            m_Levels.push_back(level);
+        }
+        if (!in.ok() || m_Levels.empty())
+            return reject(sourcePath, "truncated");
+        return true;
+    }
+
+    bool reject(const std::string &sourcePath, const std::string &reason) {
+        std::cout << "TEXTURE_CACHE:: rebaking " << sourcePath << " (" << reason << ")" << std::endl;
+        m_Levels.clear();
+        m_File.close();
+        m_Buffer.clear();
+        return false;
+    }
+};
+
+#endif //PROJECT_BASE_TEXTURECACHE_H
@@ -0,0 +1,425 @@
+#ifndef PROJECT_BASE_TEXTURELOADER_H
+#define PROJECT_BASE_TEXTURELOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <rg/Error.h>
+#include <rg/ThreadPool.h>
+#include <rg/DiskCache.h>
+#include <rg/MipChain.h>
+#include <rg/TextureCache.h>
+#include <rg/GLExtensions.h>
+#include <rg/GLObject.h>
+#include <rg/GLState.h>
+#include <rg/AssetArchive.h>
+
+// GL texture whose pixels arrive asynchronously. id stays 0 (binding it binds the default texture)
+// until the upload finished, so the handle can be stored and bound right away.
+struct TextureSlot {
+    unsigned int id = 0;
+    GLenum target = GL_TEXTURE_2D;
+    bool resident = false;
+    bool failed = false;
+    int width = 0;
+    int height = 0;
+    unsigned int pendingFaces = 1; // cubemaps become resident once all six faces are in
+    std::string path;
+    uint64_t contentHash = 0;
+    size_t gpuBytes = 0;
+    // set when another slot already holds the same image; id is then borrowed from it
+    std::shared_ptr<TextureSlot> aliasOf;
+};
+
+typedef std::shared_ptr<TextureSlot> TextureHandle;
+
+struct TextureParams {
+    GLint wrap = GL_REPEAT;
+    GLint minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLint magFilter = GL_LINEAR;
+    bool mipmaps = true;
+    // images with an alpha channel get GL_CLAMP_TO_EDGE instead of wrap (what Texture2D always did)
+    bool clampWithAlpha = false;
+    // stop in the debugger when the image can't be loaded instead of just logging it
+    bool required = false;
+    // keep the image block compressed on the GPU (BC1 opaque, BC3 with alpha, BC4 single channel), baked once
+    // into resources/cache/textures/; falls back to plain pixels when the format isn't supported
+    bool compress = false;
+    // tangent space normal map: compressed as BC5 holding only x and y, shaders rebuild z; mips are renormalized
+    bool normalMap = false;
+    // gamma encoded color (diffuse maps): mips are filtered in linear space
+    bool srgb = false;
+
+    uint64_t hash() const {
+        GLint values[4] = {wrap, minFilter, magFilter,
+                           (mipmaps ? 1 : 0) | (clampWithAlpha ? 2 : 0) | (compress ? 4 : 0) | (normalMap ? 8 : 0)
+                           | (srgb ? 16 : 0)};
+        return rg::fnv1a64(values, sizeof(values));
+    }
+};
+
+// Called on a worker thread with the hash of the file contents before decoding; returning a slot
+// makes the loaded texture an alias of it instead of decoding and uploading the same image again.
+typedef std::function<TextureHandle(const TextureHandle &slot, uint64_t contentHash)> ContentDeduplicator;
+
+// Decodes images on ThreadPool::global() and streams the pixels into GL textures through a small
+// ring of pixel unpack buffers. load*() return immediately; update() has to be called on the context
+// thread (once per frame) to finish the uploads whose decode is done. Mip chains are built on the workers too
+// (rg::buildMipChain), the GL never generates any. Images loaded with params.compress go up as their baked
+// BCn mip chain (see TextureCache) instead of decoded pixels.
+class TextureLoader {
+    struct PendingUpload {
+        TextureHandle slot;
+        TextureHandle aliasOf;
+        uint64_t contentHash = 0;
+        GLenum faceTarget;
+        TextureParams params;
+        std::vector<rg::Image> levels;            // mip chain built on the worker, just the image without mipmaps
+        std::shared_ptr<TextureCache> compressed; // set instead of levels for block compressed images
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+    };
+
+    static const unsigned int NUM_PBOS = 4;
+
+    ThreadPool &m_Pool;
+    std::mutex m_Mutex;
+    std::deque<PendingUpload> m_Ready;
+    // decodes submitted to the pool and not in m_Ready yet; the pool outlives the loader, so they're waited for
+    size_t m_Outstanding = 0;
+    std::condition_variable m_Idle;
+    rg::GLBuffer m_Pbos[NUM_PBOS];
+    unsigned int m_NextPbo = 0;
+    std::atomic<bool> m_S3tc{false};
+
+    // deleter of the handles load2D() and loadCubemap() create, like GLTexture once the context is gone it only
+    // forgets the name
+    static void releaseSlot(TextureSlot *slot) {
+        if (slot->id != 0 && !slot->aliasOf && rg::detail::glContextAlive()) {
+            rg::GLState::global().forgetTexture(slot->id);
+            glDeleteTextures(1, &slot->id);
+        }
+        delete slot;
+    }
+public:
+    explicit TextureLoader(ThreadPool &pool = ThreadPool::global()) : m_Pool(pool) {}
+    TextureLoader(const TextureLoader &) = delete;
+    TextureLoader &operator=(const TextureLoader &) = delete;
+    ~TextureLoader() {
+        wait();
+    }
+
+    static TextureLoader &global() {
+        static TextureLoader loader;
+        return loader;
+    }
+
+    TextureHandle load2D(const std::string &path, const TextureParams &params = TextureParams()) {
+        TextureHandle slot(new TextureSlot, releaseSlot);
+        load2D(slot, path, params);
+        return slot;
+    }
+
+    // loads into a slot created by the caller (TextureRegistry owns its slots and deletes their textures itself)
+    void load2D(const TextureHandle &slot, const std::string &path, const TextureParams &params,
+                ContentDeduplicator deduplicate = ContentDeduplicator()) {
+        slot->path = path;
+        decode(slot, GL_TEXTURE_2D, path, params, deduplicate);
+    }
+
+    // context thread, once after the GL is loaded: without GL_EXT_texture_compression_s3tc only BC4/BC5
+    // (core RGTC) are used and color images stay uncompressed
+    void detectCompressedFormats() {
+        m_S3tc = rg::hasExtension("GL_EXT_texture_compression_s3tc");
+    }
+
+    // faces in the usual +X, -X, +Y, -Y, +Z, -Z order
+    TextureHandle loadCubemap(const std::vector<std::string> &faces) {
+        TextureHandle slot(new TextureSlot, releaseSlot);
+        slot->target = GL_TEXTURE_CUBE_MAP;
+        slot->pendingFaces = (unsigned int) faces.size();
+        slot->path = faces.empty() ? std::string() : faces[0];
+        TextureParams params;
+        params.wrap = GL_CLAMP_TO_EDGE;
+        params.minFilter = GL_LINEAR;
+        params.mipmaps = false;
+        params.required = true;
+        for (unsigned int i = 0; i < faces.size(); i++)
+            decode(slot, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faces[i], params);
+        return slot;
+    }
+
+    // blocks until every decode submitted so far is done; their uploads stay queued for update()
+    void wait() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Idle.wait(lock, [this] { return m_Outstanding == 0; });
+    }
+
+    // drops the decoded images update() hasn't uploaded yet, their slots stay empty
+    void discard() {
+        // released after the lock, the slots' deleters may call back into their owner
+        std::deque<PendingUpload> dropped;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            dropped.swap(m_Ready);
+        }
+    }
+
+    // context thread only: uploads decoded images until about byteBudget bytes went through this frame
+    void update(size_t byteBudget = 32u << 20) {
+        size_t uploaded = 0;
+        size_t queued;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            queued = m_Ready.size();
+        }
+        // aliases waiting for their original go to the back, so only look at what is queued right now
+        for (; queued > 0 && uploaded < byteBudget; queued--) {
+            PendingUpload item;
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                if (m_Ready.empty())
+                    break;
+                item = std::move(m_Ready.front());
+                m_Ready.pop_front();
+            }
+            uploaded += upload(item);
+        }
+    }
+
+private:
+    void decode(const TextureHandle &slot, GLenum faceTarget, const std::string &path, const TextureParams &params,
+                ContentDeduplicator deduplicate = ContentDeduplicator()) {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Outstanding++;
+        }
+        m_Pool.submit([this, slot, faceTarget, path, params, deduplicate]() mutable {
+            PendingUpload item;
+            item.faceTarget = faceTarget;
+            item.params = params;
+            // zero copy: a view into the asset archive or a mapping of the loose file
+            rg::AssetFile contents;
+            contents.open(path);
+            if (deduplicate && contents.size() > 0) {
+                item.contentHash = rg::fnv1a64(contents.data(), contents.size());
+                item.aliasOf = deduplicate(slot, item.contentHash);
+            }
+            if (!item.aliasOf && !(params.compress && loadCompressed(item, path, contents))) {
+                unsigned char *data = stbi_load_from_memory((const stbi_uc *) contents.data(), (int) contents.size(),
+                                                            &item.width, &item.height, &item.channels, 0);
+                if (data) {
+                    rg::Image image;
+                    image.width = item.width;
+                    image.height = item.height;
+                    image.channels = item.channels;
+                    image.pixels.assign(data, data + (size_t) item.width * item.height * item.channels);
+                    stbi_image_free(data);
+                    if (params.mipmaps)
+                        item.levels = rg::buildMipChain(std::move(image), mipOptions(params, item.channels));
+                    else
+                        item.levels.push_back(std::move(image));
+                } else {
+                    std::cout << "Texture failed to load at path: " << path << std::endl;
+                }
+            }
+            item.slot = std::move(slot);
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Ready.push_back(std::move(item));
+            m_Outstanding--;
+            m_Idle.notify_all();
+        });
+    }
+
+    // worker thread: the baked BCn mip chain of the image, baking it first on a cache miss.
+    // false leaves item untouched so the caller decodes the plain pixels instead
+    bool loadCompressed(PendingUpload &item, const std::string &path, const rg::AssetFile &contents) {
+        int width, height, channels;
+        if (!stbi_info_from_memory((const stbi_uc *) contents.data(), (int) contents.size(), &width, &height, &channels))
+            return false;
+        rg::BlockFormat format;
+        if (item.params.normalMap)
+            format = rg::BlockFormat::BC5;
+        else if (channels == 1)
+            format = rg::BlockFormat::BC4;
+        else if (!m_S3tc)
+            return false;
+        else
+            format = (channels == 2 || channels == 4) ? rg::BlockFormat::BC3 : rg::BlockFormat::BC1;
+
+        std::shared_ptr<TextureCache> cache = std::make_shared<TextureCache>();
+        rg::MipOptions options = mipOptions(item.params, channels);
+        if (!cache->open(path, format, options)) {
+            unsigned char *rgba = stbi_load_from_memory((const stbi_uc *) contents.data(), (int) contents.size(),
+                                                        &width, &height, &channels, 4);
+            if (!rgba)
+                return false;
+            bool baked = cache->bake(path, format, options, rgba, width, height, channels);
+            stbi_image_free(rgba);
+            if (!baked)
+                return false;
+        }
+        item.compressed = cache;
+        item.width = cache->levels()[0].width;
+        item.height = cache->levels()[0].height;
+        item.channels = cache->channels();
+        return true;
+    }
+
+    static rg::MipOptions mipOptions(const TextureParams &params, int channels) {
+        rg::MipOptions options;
+        options.srgb = params.srgb && !params.normalMap;
+        options.normalMap = params.normalMap;
+        GLint wrap = (params.clampWithAlpha && channels == 4) ? GL_CLAMP_TO_EDGE : params.wrap;
+        options.wrap = wrap == GL_REPEAT || wrap == GL_MIRRORED_REPEAT;
+        return options;
+    }
+
+    // same image as an already loaded slot: borrow its GL texture once it is there
+    void resolveAlias(PendingUpload &item) {
+        TextureSlot &slot = *item.slot;
+        const TextureSlot &original = *item.aliasOf;
+        if (original.failed) {
+            slot.failed = true;
+        } else if (original.resident) {
+            slot.aliasOf = item.aliasOf;
+            slot.id = original.id;
+            slot.width = original.width;
+            slot.height = original.height;
+            slot.resident = true;
+        } else {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Ready.push_back(std::move(item));
+        }
+    }
+
+    // returns the number of bytes pushed to the GL
+    size_t upload(PendingUpload &item) {
+        TextureSlot &slot = *item.slot;
+        slot.contentHash = item.contentHash;
+        if (item.aliasOf) {
+            resolveAlias(item);
+            return 0;
+        }
+        if (item.compressed)
+            return uploadCompressed(item);
+        if (item.levels.empty()) {
+            slot.failed = true;
+            ASSERT(!item.params.required, "Failed to load texture!\n");
+            return 0;
+        }
+
+        GLenum format = GL_RGB;
+        if (item.channels == 1)
+            format = GL_RED;
+        else if (item.channels == 3)
+            format = GL_RGB;
+        else if (item.channels == 4)
+            format = GL_RGBA;
+
+        createTexture(slot, item.params, format == GL_RGBA);
+        slot.width = item.width;
+        slot.height = item.height;
+
+        // the mip chain came from the worker, level by level; nothing is generated here
+        size_t uploaded = 0;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // rows of RGB images aren't 4 byte aligned
+        for (size_t i = 0; i < item.levels.size(); i++) {
+            const rg::Image &level = item.levels[i];
+            const void *source = stage(level.pixels.data(), level.pixels.size());
+            rg::GLState::global().bindTexture(slot.target, slot.id);
+            if (i == 0 && item.params.mipmaps)
+                glTexParameteri(slot.target, GL_TEXTURE_MAX_LEVEL, (GLint) item.levels.size() - 1);
+            glTexImage2D(item.faceTarget, (GLint) i, format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, source);
+            uploaded += level.pixels.size();
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        slot.gpuBytes += uploaded;
+        if (--slot.pendingFaces == 0)
+            slot.resident = true;
+        return uploaded;
+    }
+
+    // baked mip chain, every level goes up as it is
+    size_t uploadCompressed(PendingUpload &item) {
+        TextureSlot &slot = *item.slot;
+        const TextureCache &cache = *item.compressed;
+        const std::vector<TextureCache::Level> &levels = cache.levels();
+        size_t numLevels = item.params.mipmaps ? levels.size() : 1;
+
+        createTexture(slot, item.params, cache.channels() == 4);
+        slot.width = item.width;
+        slot.height = item.height;
+
+        size_t size = (size_t) (levels[numLevels - 1].data + levels[numLevels - 1].size - levels[0].data);
+        uintptr_t source = (uintptr_t) stage(levels[0].data, size);
+        rg::GLState::global().bindTexture(slot.target, slot.id);
+        glTexParameteri(slot.target, GL_TEXTURE_MAX_LEVEL, (GLint) numLevels - 1);
+        GLenum format = TextureCache::glFormat(cache.format());
+        for (size_t i = 0; i < numLevels; i++) {
+            const TextureCache::Level &level = levels[i];
+            glCompressedTexImage2D(item.faceTarget, (GLint) i, format, level.width, level.height, 0, level.size,
+                                   (const void *) (source + (uintptr_t) (level.data - levels[0].data)));
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        slot.gpuBytes += size;
+        if (--slot.pendingFaces == 0)
+            slot.resident = true;
+        return size;
+    }
+
+    // first upload into the slot: creates the texture object and sets its sampling state
+    void createTexture(TextureSlot &slot, const TextureParams &params, bool hasAlpha) {
+        if (slot.id != 0)
+            return;
+        glGenTextures(1, &slot.id);
+        rg::GLState::global().bindTexture(slot.target, slot.id);
+        GLint wrap = (params.clampWithAlpha && hasAlpha) ? GL_CLAMP_TO_EDGE : params.wrap;
+        glTexParameteri(slot.target, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(slot.target, GL_TEXTURE_WRAP_T, wrap);
+        if (slot.target == GL_TEXTURE_CUBE_MAP)
+            glTexParameteri(slot.target, GL_TEXTURE_WRAP_R, wrap);
+        glTexParameteri(slot.target, GL_TEXTURE_MIN_FILTER, params.minFilter);
+        glTexParameteri(slot.target, GL_TEXTURE_MAG_FILTER, params.magFilter);
+    }
+
+    // copies data into the next buffer of the ring and leaves it bound to GL_PIXEL_UNPACK_BUFFER; respecifying
+    // its storage first orphans whatever transfer the driver may still be doing out of it, so this never waits
+    // on the GPU. returns what to pass as the pixel pointer: an offset into the buffer, or data itself if mapping failed
+    const void *stage(const void *data, size_t size) {
+        if (!m_Pbos[0])
+            for (rg::GLBuffer &pbo : m_Pbos)
+                pbo = rg::GLBuffer::create();
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Pbos[m_NextPbo].id());
+        m_NextPbo = (m_NextPbo + 1) % NUM_PBOS;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped)
+            memcpy(mapped, data, size);
+        if (!mapped || glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE) {
+            // no PBO this time, upload straight from client memory
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return data;
+        }
+        return nullptr;
+    }
+};
+
+#endif //PROJECT_BASE_TEXTURELOADER_H
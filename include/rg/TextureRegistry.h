@@ -0,0 +1,161 @@
+#ifndef PROJECT_BASE_TEXTUREREGISTRY_H
+#define PROJECT_BASE_TEXTUREREGISTRY_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <climits>
+#include <cstdlib>
+
+#include <rg/TextureLoader.h>
+#include <rg/GLState.h>
+
+// Process wide set of loaded 2D textures, so every image is decoded and resident once no matter how many
+// models and Texture2D objects use it. Lookups go through two hash maps: canonical path (plus sampling
+// parameters) when a texture is requested and content hash when the worker has read the file, which
+// catches copies of the same image under different names. Handles are reference counted; the GL texture
+// is deleted when the last one goes away.
+class TextureRegistry {
+public:
+    struct EntryInfo {
+        std::string path;
+        long references;
+        int width;
+        int height;
+        size_t gpuBytes;
+        bool resident;
+        bool alias; // shares the GL texture of another entry with the same contents
+    };
+
+    explicit TextureRegistry(TextureLoader &loader = TextureLoader::global()) : m_Loader(loader) {}
+    TextureRegistry(const TextureRegistry &) = delete;
+    TextureRegistry &operator=(const TextureRegistry &) = delete;
+    // the loader's decodes call claimContent() and its queued uploads hold slots that release() into this
+    ~TextureRegistry() {
+        m_Loader.wait();
+        m_Loader.discard();
+    }
+
+    static TextureRegistry &global() {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    TextureHandle acquire(const std::string &path, const TextureParams &params = TextureParams()) {
+        uint64_t paramsHash = params.hash();
+        std::string key = canonicalPath(path) + '#' + rg::toHex(paramsHash);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto found = m_ByPath.find(key);
+        if (found != m_ByPath.end()) {
+            if (TextureHandle existing = found->second.lock())
+                return existing;
+        }
+
+        TextureHandle slot(new TextureSlot, [this, key, paramsHash](TextureSlot *slot) { release(key, paramsHash, slot); });
+        m_ByPath[key] = slot;
+        m_Loader.load2D(slot, path, params, [this, paramsHash](const TextureHandle &slot, uint64_t contentHash) {
+            return claimContent(slot, contentKey(contentHash, paramsHash));
+        });
+        return slot;
+    }
+
+    std::vector<EntryInfo> entries() {
+        std::vector<EntryInfo> result;
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (const auto &entry : m_ByPath) {
+            TextureHandle slot = entry.second.lock();
+            if (!slot)
+                continue;
+            result.push_back({slot->path, slot.use_count() - 1, slot->width, slot->height,
+                              slot->gpuBytes, slot->resident, slot->aliasOf != nullptr});
+        }
+        std::sort(result.begin(), result.end(), [](const EntryInfo &a, const EntryInfo &b) {
+            return a.gpuBytes > b.gpuBytes;
+        });
+        return result;
+    }
+
+    size_t totalGpuBytes() {
+        size_t total = 0;
+        for (const EntryInfo &entry : entries())
+            total += entry.gpuBytes;
+        return total;
+    }
+
+    void report(std::ostream &out) {
+        size_t total = 0;
+        for (const EntryInfo &entry : entries()) {
+            out << std::setw(10) << entry.gpuBytes << " B  " << entry.width << "x" << entry.height
+                << "  refs " << entry.references << (entry.alias ? "  (alias)  " : "  ") << entry.path << '\n';
+            total += entry.gpuBytes;
+        }
+        out << std::setw(10) << total << " B  total" << std::endl;
+    }
+
+    // the context is about to be destroyed; handles released after this don't call into GL anymore
+    void shutdown() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_ContextAlive = false;
+    }
+
+private:
+    TextureLoader &m_Loader;
+    std::mutex m_Mutex;
+    std::unordered_map<std::string, std::weak_ptr<TextureSlot>> m_ByPath;
+    std::unordered_map<uint64_t, std::weak_ptr<TextureSlot>> m_ByContent;
+    bool m_ContextAlive = true;
+
+    static std::string canonicalPath(const std::string &path) {
+        char resolved[PATH_MAX];
+        return realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+    }
+
+    static uint64_t contentKey(uint64_t contentHash, uint64_t paramsHash) {
+        return contentHash ^ (paramsHash * 0x9e3779b97f4a7c15ull);
+    }
+
+    // worker thread: first slot to show up with some contents owns them, later ones become aliases
+    TextureHandle claimContent(const TextureHandle &slot, uint64_t key) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto found = m_ByContent.find(key);
+        if (found != m_ByContent.end()) {
+            TextureHandle existing = found->second.lock();
+            if (existing && existing != slot)
+                return existing;
+        }
+        m_ByContent[key] = slot;
+        return nullptr;
+    }
+
+    // deleter of the handles, runs when the last reference to a slot is dropped
+    void release(const std::string &key, uint64_t paramsHash, TextureSlot *slot) {
+        bool deleteTexture;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            // the maps may already point at a newer slot for the same key, leave those alone
+            auto byPath = m_ByPath.find(key);
+            if (byPath != m_ByPath.end() && byPath->second.expired())
+                m_ByPath.erase(byPath);
+            auto byContent = m_ByContent.find(contentKey(slot->contentHash, paramsHash));
+            if (byContent != m_ByContent.end() && byContent->second.expired())
+                m_ByContent.erase(byContent);
+            deleteTexture = m_ContextAlive && slot->id != 0 && !slot->aliasOf;
+        }
+        if (deleteTexture) {
+            rg::GLState::global().forgetTexture(slot->id);
+            glDeleteTextures(1, &slot->id);
+        }
+        // outside the lock: dropping an alias may release the slot it points to
+        delete slot;
+    }
+};
+
+#endif //PROJECT_BASE_TEXTUREREGISTRY_H
@@ -0,0 +1,117 @@
+#ifndef PROJECT_BASE_THREADPOOL_H
+#define PROJECT_BASE_THREADPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+// Fixed set of worker threads for CPU only work (parsing, decoding, baking).
+// Workers never touch OpenGL; anything that needs the context goes through GLTaskQueue.
+class ThreadPool {
+    std::vector<std::thread> m_Workers;
+    std::deque<std::function<void()>> m_Tasks;
+    std::mutex m_Mutex;
+    std::condition_variable m_Condition;
+    bool m_Stopping = false;
+public:
+    explicit ThreadPool(unsigned int numThreads = std::max(1u, std::thread::hardware_concurrency())) {
+        for (unsigned int i = 0; i < numThreads; i++)
+            m_Workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // finishes the queued tasks, then joins
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stopping = true;
+        }
+        m_Condition.notify_all();
+        for (std::thread &worker : m_Workers)
+            worker.join();
+    }
+
+    // pool shared by all loaders, created on first use
+    static ThreadPool &global() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    template<typename F>
+    auto submit(F task) -> std::future<decltype(task())> {
+        auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+        std::future<decltype(task())> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Tasks.emplace_back([packaged] { (*packaged)(); });
+        }
+        m_Condition.notify_one();
+        return result;
+    }
+
+    // runs body(i) for every i in [0, count) on the workers and the calling thread, returns when all are done.
+    // the caller works through the items itself rather than blocking on the queue, so workers may call it too
+    template<typename F>
+    void parallelFor(size_t count, F body) {
+        if (count == 0)
+            return;
+        struct State {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> done{0};
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        std::shared_ptr<State> state = std::make_shared<State>();
+        // helpers that only start once every item is taken return without touching body
+        auto run = [state, count, &body] {
+            for (size_t i = state->next++; i < count; i = state->next++) {
+                body(i);
+                if (++state->done == count) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            }
+        };
+        size_t helpers = std::min(count, (size_t) m_Workers.size()) - 1;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            for (size_t i = 0; i < helpers; i++)
+                m_Tasks.emplace_back(run);
+        }
+        m_Condition.notify_all();
+        run();
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&state, count] { return state->done == count; });
+    }
+
+    unsigned int size() const {
+        return (unsigned int) m_Workers.size();
+    }
+
+private:
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Condition.wait(lock, [this] { return m_Stopping || !m_Tasks.empty(); });
+                if (m_Tasks.empty())
+                    return;
+                task = std::move(m_Tasks.front());
+                m_Tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+
+#endif //PROJECT_BASE_THREADPOOL_H
@@ -0,0 +1,73 @@
+#ifndef PROJECT_BASE_VERTEXPACKING_H
+#define PROJECT_BASE_VERTEXPACKING_H
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+// 20 byte GPU vertex, the compact alternative to the 56 byte float Vertex of learnopengl/mesh.h:
+//   Position   4 x unorm16  xyz relative to the mesh bounds (shader: aPos.xyz * positionScale + positionOffset),
+//                           w is the handedness of the tangent frame (0 -> -1, 1 -> +1)
+//   Normal     2 x snorm16  octahedral
+//   TexCoords  2 x half
+//   Tangent    2 x snorm16  octahedral; the bitangent is cross(Normal, Tangent) * handedness
+struct PackedVertex {
+    uint16_t Position[4];
+    int16_t Normal[2];
+    uint16_t TexCoords[2];
+    int16_t Tangent[2];
+};
+
+namespace rg {
+
+    // unit vector to the octahedron unfolded onto [-1, 1]^2; a zero vector maps to +z
+    glm::vec2 octEncode(glm::vec3 n) {
+        float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+        if (l1 <= 0.0f)
+            return glm::vec2(0.0f);
+        n /= l1;
+        glm::vec2 p(n.x, n.y);
+        if (n.z < 0.0f) {
+            p.x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+            p.y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return p;
+    }
+
+    // inverse of octEncode, same as octDecode() in the vertex shaders
+    glm::vec3 octDecode(glm::vec2 e) {
+        glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+        float t = std::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
+
+    // positions are quantized to the box [positionOffset, positionOffset + positionScale]
+    PackedVertex packVertex(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoords,
+                            const glm::vec3 &tangent, const glm::vec3 &bitangent,
+                            const glm::vec3 &positionOffset, const glm::vec3 &positionScale) {
+        PackedVertex packed;
+        for (int i = 0; i < 3; i++) {
+            float t = positionScale[i] > 0.0f ? (position[i] - positionOffset[i]) / positionScale[i] : 0.0f;
+            packed.Position[i] = glm::packUnorm1x16(t);
+        }
+        bool rightHanded = glm::dot(glm::cross(normal, tangent), bitangent) >= 0.0f;
+        packed.Position[3] = rightHanded ? 0xffff : 0;
+
+        glm::vec2 n = octEncode(normal), t = octEncode(tangent);
+        packed.Normal[0] = (int16_t) glm::packSnorm1x16(n.x);
+        packed.Normal[1] = (int16_t) glm::packSnorm1x16(n.y);
+        packed.Tangent[0] = (int16_t) glm::packSnorm1x16(t.x);
+        packed.Tangent[1] = (int16_t) glm::packSnorm1x16(t.y);
+        packed.TexCoords[0] = glm::packHalf1x16(texCoords.x);
+        packed.TexCoords[1] = glm::packHalf1x16(texCoords.y);
+        return packed;
+    }
+
+};
+
+#endif //PROJECT_BASE_VERTEXPACKING_H
@@ -0,0 +1,401 @@
+#ifndef PROJECT_BASE_WORLDPARTITION_H
+#define PROJECT_BASE_WORLDPARTITION_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+#include <rg/Scene.h>
+#include <rg/Texture2D.h>
+#include <rg/LodSelection.h>
+#include <rg/MaterialAtlas.h>
+#include <rg/ThreadPool.h>
+#include <rg/GLTaskQueue.h>
+#include <rg/GLState.h>
+
+// The scene split into square cells on the xz plane. A cell owns the instances and decals placed in it (by their
+// translation) and through them references the models and decal textures it needs; WorldStreamer keeps only the
+// cells around the camera, and so only those assets, loaded.
+namespace rg {
+
+    struct WorldCell {
+        int x = 0;                 // grid coordinates: the cell covers [x, x + 1) * cellSize on the world x axis
+        int z = 0;                 // and [z, z + 1) * cellSize on the z axis
+        glm::vec2 min, max;        // that extent in world units
+        std::vector<uint32_t> models;        // scene models with instances here, ascending
+        std::vector<uint32_t> firstInstance; // per entry of models, where its instances start; plus the end
+        std::vector<uint32_t> instances;     // scene instance indices, grouped like models
+        std::vector<uint32_t> decals;        // scene decal indices
+        std::vector<uint32_t> decalTextures; // scene decal texture indices used by decals, ascending
+    };
+
+    class WorldPartition {
+    public:
+        WorldPartition(const Scene &scene, float cellSize) : m_CellSize(cellSize) {
+            std::map<std::pair<int, int>, uint32_t> index;
+            auto cellAt = [&](const glm::vec4 &position) -> WorldCell & {
+                std::pair<int, int> key((int) std::floor(position.x / cellSize), (int) std::floor(position.z / cellSize));
+                auto found = index.find(key);
+                if (found == index.end()) {
+                    found = index.insert(std::make_pair(key, (uint32_t) m_Cells.size())).first;
+                    WorldCell cell;
+                    cell.x = key.first;
+                    cell.z = key.second;
+                    cell.min = glm::vec2(key.first, key.second) * cellSize;
+                    cell.max = cell.min + glm::vec2(cellSize);
+                    m_Cells.push_back(cell);
+                }
+                return m_Cells[found->second];
+            };
+
+            // the scene stores the instances grouped by model, so every cell gets them grouped the same way
+            for (uint32_t m = 0; m < scene.models().size(); m++) {
+                const SceneModel &model = scene.models()[m];
+                for (uint32_t i = model.firstInstance; i < model.firstInstance + model.numInstances; i++) {
+                    WorldCell &cell = cellAt(scene.instances()[i][3]);
+                    if (cell.models.empty() || cell.models.back() != m) {
+                        cell.models.push_back(m);
+                        cell.firstInstance.push_back((uint32_t) cell.instances.size());
+                    }
+                    cell.instances.push_back(i);
+                }
+            }
+            for (uint32_t d = 0; d < scene.numDecals(); d++) {
+                WorldCell &cell = cellAt(scene.decals()[d].transform[3]);
+                cell.decals.push_back(d);
+                cell.decalTextures.push_back(scene.decals()[d].texture);
+            }
+            for (WorldCell &cell : m_Cells) {
+                cell.firstInstance.push_back((uint32_t) cell.instances.size());
+                std::sort(cell.decalTextures.begin(), cell.decalTextures.end());
+                cell.decalTextures.erase(std::unique(cell.decalTextures.begin(), cell.decalTextures.end()),
+                                         cell.decalTextures.end());
+            }
+        }
+
+        float cellSize() const { return m_CellSize; }
+        const std::vector<WorldCell> &cells() const { return m_Cells; }
+
+        // from position to the nearest point of the cell, on the xz plane; 0 inside it
+        static float distance(const WorldCell &cell, const glm::vec3 &position) {
+            glm::vec2 p(position.x, position.z);
+            return glm::length(p - glm::clamp(p, cell.min, cell.max));
+        }
+
+    private:
+        float m_CellSize;
+        std::vector<WorldCell> m_Cells;
+    };
+
+    struct StreamingSettings {
+        float loadRadius = 32.0f;   // cells closer to the camera than this are loaded
+        float unloadRadius = 40.0f; // and dropped again once farther than this
+        size_t memoryBudget = (size_t) 512 << 20; // GPU bytes of the loaded models and decal textures
+        unsigned int maxUploadsPerFrame = 2;      // model uploads finished per update()
+        unsigned int instanceAttribute = 3;       // first matrix attribute of the instanced models
+        std::string samplerPrefix = "material.";  // given to every model loaded
+        // when set the instanced models get one layer each (in scene order) and draw their material from there;
+        // their own textures aren't loaded then
+        MaterialAtlas *atlas = nullptr;
+    };
+
+    // Loads and unloads the cells of a partition as the camera moves. Models are imported on the thread pool and
+    // uploaded by update(), a few per frame; a cell is drawn (listed in residentCells()) once all its models are in.
+    // Models and decal textures are reference counted by the cells that want them and unloaded with the last one.
+    // Nearer cells come first: a cell whose assets don't fit in the budget makes the loaded cells farther than it
+    // go, and when that isn't enough it and everything farther waits. The size of a model is only known once it was
+    // loaded, so the first load of each one is let through on the radius alone.
+    // Context thread only.
+    class WorldStreamer {
+    public:
+        WorldStreamer(const Scene &scene, const WorldPartition &partition,
+                      const StreamingSettings &settings = StreamingSettings(), ThreadPool &pool = ThreadPool::global())
+                : m_Scene(scene), m_Partition(partition), m_Settings(settings), m_Pool(pool),
+                  m_Uploads(std::make_shared<GLTaskQueue>()), m_Models(scene.models().size()),
+                  m_Instances(scene.models().size()), m_DecalTextures(scene.decalTextures().size()),
+                  m_States(partition.cells().size(), CellState::Unloaded),
+                  m_Distances(partition.cells().size(), 0.0f) {
+            for (uint32_t i = 0; i < m_States.size(); i++)
+                m_Order.push_back(i);
+            unsigned int layers = 0;
+            for (uint32_t m = 0; m < m_Models.size(); m++)
+                if (usesAtlas(m))
+                    m_Models[m].atlasLayer = layers++;
+        }
+        WorldStreamer(const WorldStreamer &) = delete;
+        WorldStreamer &operator=(const WorldStreamer &) = delete;
+
+        // layers the material atlas needs for scene
+        static unsigned int atlasLayers(const Scene &scene) {
+            unsigned int layers = 0;
+            for (const SceneModel &model : scene.models())
+                layers += (model.flags & SCENE_MODEL_INSTANCED) != 0;
+            return layers;
+        }
+
+        // once per frame: finishes some uploads, then loads and unloads cells for a camera at viewPos
+        void update(const glm::vec3 &viewPos) {
+            m_Uploads->runPending(m_Settings.maxUploadsPerFrame);
+
+            const std::vector<WorldCell> &cells = m_Partition.cells();
+            for (uint32_t i = 0; i < cells.size(); i++) {
+                m_Distances[i] = WorldPartition::distance(cells[i], viewPos);
+                if (m_States[i] != CellState::Unloaded && m_Distances[i] > m_Settings.unloadRadius)
+                    release(i);
+            }
+            std::sort(m_Order.begin(), m_Order.end(), [this](uint32_t a, uint32_t b) {
+                return m_Distances[a] < m_Distances[b];
+            });
+
+            // textures measure in as they finish: when that went over, the farthest cells go (never the nearest)
+            m_UsedBytes = acquiredBytes();
+            for (size_t i = m_Order.size(); i-- > 1 && m_UsedBytes > m_Settings.memoryBudget;) {
+                if (m_States[m_Order[i]] != CellState::Unloaded) {
+                    release(m_Order[i]);
+                    m_UsedBytes = acquiredBytes();
+                }
+            }
+
+            for (size_t i = 0; i < m_Order.size() && m_Distances[m_Order[i]] <= m_Settings.loadRadius; i++) {
+                uint32_t cell = m_Order[i];
+                if (m_States[cell] != CellState::Unloaded)
+                    continue;
+                size_t needed = missingBytes(cell);
+                for (size_t j = m_Order.size(); j-- > i + 1 && m_UsedBytes + needed > m_Settings.memoryBudget;) {
+                    if (m_States[m_Order[j]] != CellState::Unloaded) {
+                        release(m_Order[j]);
+                        m_UsedBytes = acquiredBytes();
+                        needed = missingBytes(cell);
+                    }
+                }
+                if (m_UsedBytes > 0 && m_UsedBytes + needed > m_Settings.memoryBudget)
+                    break;
+                acquire(cell);
+                m_UsedBytes += needed;
+            }
+
+            for (uint32_t i = 0; i < cells.size(); i++)
+                if (m_States[i] == CellState::Loading && loaded(cells[i]))
+                    makeResident(i);
+            if (m_ResidentChanged) {
+                m_Resident.clear();
+                for (uint32_t i = 0; i < cells.size(); i++)
+                    if (m_States[i] == CellState::Resident)
+                        m_Resident.push_back(i);
+                rebuildInstances();
+                m_ResidentChanged = false;
+                m_ResidentGeneration++;
+            }
+        }
+
+        // blocks until every cell update() wants at viewPos is resident; for the first frame
+        void wait(const glm::vec3 &viewPos) {
+            update(viewPos);
+            while (std::find(m_States.begin(), m_States.end(), CellState::Loading) != m_States.end()) {
+                m_Uploads->waitAndRunOne();
+                update(viewPos);
+            }
+        }
+
+        // cells to draw, indices into the partition's cells
+        const std::vector<uint32_t> &residentCells() const { return m_Resident; }
+        // changes whenever residentCells() does, for whatever is built from their contents
+        unsigned int residentGeneration() const { return m_ResidentGeneration; }
+
+        // the model of scene model m, nullptr while no resident cell has it
+        Model *model(uint32_t m) const { return m_Models[m].model.get(); }
+        // instance buffer of an instanced model: its instances in the resident cells
+        InstanceLodBuckets &instances(uint32_t m) { return m_Instances[m]; }
+        // decal texture t, nullptr while no resident cell has it
+        Texture2D *decalTexture(uint32_t t) const { return m_DecalTextures[t].texture.get(); }
+
+        // what the loaded and loading cells take, as of the last update()
+        size_t usedBytes() const { return m_UsedBytes; }
+        const StreamingSettings &settings() const { return m_Settings; }
+
+    private:
+        enum class CellState { Unloaded, Loading, Resident };
+
+        struct ModelSlot {
+            std::unique_ptr<Model> model; // set once the upload ran
+            unsigned int references = 0;  // cells loading or resident that have instances of it
+            unsigned int generation = 0;  // bumped on every load, the uploads of an older one are dropped
+            size_t bytes = 0;             // last measured size, the estimate while it loads again
+            unsigned int atlasLayer = 0;  // its material in the atlas, see usesAtlas()
+        };
+
+        struct DecalTextureSlot {
+            std::unique_ptr<Texture2D> texture;
+            unsigned int references = 0;
+            size_t bytes = 0;
+        };
+
+        const Scene &m_Scene;
+        const WorldPartition &m_Partition;
+        StreamingSettings m_Settings;
+        ThreadPool &m_Pool;
+        // shared with the imports still running, which post to it even after the streamer is gone
+        std::shared_ptr<GLTaskQueue> m_Uploads;
+        std::vector<ModelSlot> m_Models;
+        std::vector<InstanceLodBuckets> m_Instances;
+        std::vector<DecalTextureSlot> m_DecalTextures;
+        std::vector<CellState> m_States;
+        std::vector<float> m_Distances;
+        std::vector<uint32_t> m_Order; // cells by distance, nearest first
+        std::vector<uint32_t> m_Resident;
+        bool m_ResidentChanged = false;
+        unsigned int m_ResidentGeneration = 0;
+        size_t m_UsedBytes = 0;
+
+        void acquire(uint32_t cell) {
+            const WorldCell &worldCell = m_Partition.cells()[cell];
+            for (uint32_t m : worldCell.models)
+                if (m_Models[m].references++ == 0)
+                    loadModel(m);
+            for (uint32_t t : worldCell.decalTextures)
+                if (m_DecalTextures[t].references++ == 0)
+                    m_DecalTextures[t].texture.reset(
+                            new Texture2D(m_Scene.decalTextures()[t], GL_REPEAT, GL_LINEAR, true));
+            m_States[cell] = CellState::Loading;
+        }
+
+        void release(uint32_t cell) {
+            const WorldCell &worldCell = m_Partition.cells()[cell];
+            for (uint32_t m : worldCell.models) {
+                ModelSlot &slot = m_Models[m];
+                if (--slot.references == 0) {
+                    slot.model.reset();
+                    slot.generation++;
+                }
+            }
+            for (uint32_t t : worldCell.decalTextures)
+                if (--m_DecalTextures[t].references == 0)
+                    m_DecalTextures[t].texture.reset();
+            m_ResidentChanged |= m_States[cell] == CellState::Resident;
+            m_States[cell] = CellState::Unloaded;
+        }
+
+        void makeResident(uint32_t cell) {
+            m_States[cell] = CellState::Resident;
+            m_ResidentChanged = true;
+        }
+
+        bool loaded(const WorldCell &cell) const {
+            for (uint32_t m : cell.models)
+                if (!m_Models[m].model)
+                    return false;
+            return true;
+        }
+
+        bool usesAtlas(uint32_t m) const {
+            return m_Settings.atlas && (m_Scene.models()[m].flags & SCENE_MODEL_INSTANCED);
+        }
+
+        // Model::import (and the atlas layer's decode) on the pool, Model::upload on the next update()s
+        void loadModel(uint32_t m) {
+            unsigned int generation = ++m_Models[m].generation;
+            std::shared_ptr<GLTaskQueue> uploads = m_Uploads;
+            std::string path = m_Scene.models()[m].path;
+            int atlasSize = usesAtlas(m) ? m_Settings.atlas->size() : 0;
+            m_Pool.submit([this, uploads, path, m, generation, atlasSize] {
+                std::shared_ptr<ModelData> data = std::make_shared<ModelData>();
+                try {
+                    *data = Model::import(path);
+                } catch (const std::exception &e) {
+                    std::cout << "ERROR::WORLD_STREAMER:: " << path << ": " << e.what() << std::endl;
+                }
+                std::shared_ptr<MaterialLayer> layer;
+                if (atlasSize > 0) {
+                    layer = std::make_shared<MaterialLayer>(MaterialAtlas::decode(*data, atlasSize));
+                    for (MeshData &mesh : data->meshes)
+                        mesh.textures.clear();
+                }
+                // only run by update(), so the streamer is alive whenever this does
+                uploads->post([this, m, generation, data, layer] {
+                    ModelSlot &slot = m_Models[m];
+                    if (slot.generation != generation)
+                        return;
+                    if (layer)
+                        m_Settings.atlas->upload(slot.atlasLayer, *layer);
+                    const SceneModel &sceneModel = m_Scene.models()[m];
+                    slot.model.reset(new Model(sceneModel.flags & SCENE_MODEL_PACKED ? VertexFormat::Packed
+                                                                                     : VertexFormat::Float));
+                    slot.model->SetShaderTextureNamePrefix(m_Settings.samplerPrefix);
+                    slot.model->upload(std::move(*data));
+                    slot.bytes = slot.model->GpuBytes();
+                });
+            });
+        }
+
+        // current size of everything the loading and resident cells hold; remembered for when it loads again
+        size_t acquiredBytes() {
+            size_t bytes = 0;
+            for (ModelSlot &slot : m_Models) {
+                if (slot.references == 0)
+                    continue;
+                if (slot.model)
+                    slot.bytes = slot.model->GpuBytes();
+                bytes += slot.bytes;
+            }
+            for (DecalTextureSlot &slot : m_DecalTextures) {
+                if (slot.references == 0)
+                    continue;
+                slot.bytes = std::max(slot.bytes, slot.texture->handle()->gpuBytes);
+                bytes += slot.bytes;
+            }
+            return bytes;
+        }
+
+        // what loading cell would add on top of the cells already held
+        size_t missingBytes(uint32_t cell) const {
+            const WorldCell &worldCell = m_Partition.cells()[cell];
+            size_t bytes = 0;
+            for (uint32_t m : worldCell.models)
+                if (m_Models[m].references == 0)
+                    bytes += m_Models[m].bytes;
+            for (uint32_t t : worldCell.decalTextures)
+                if (m_DecalTextures[t].references == 0)
+                    bytes += m_DecalTextures[t].bytes;
+            return bytes;
+        }
+
+        // instance buffers of the instanced models from the instances of the resident cells
+        void rebuildInstances() {
+            const std::vector<WorldCell> &cells = m_Partition.cells();
+            std::vector<glm::mat4> matrices;
+            for (uint32_t m = 0; m < m_Models.size(); m++) {
+                const Model *model = m_Models[m].model.get();
+                if (!model || !(m_Scene.models()[m].flags & SCENE_MODEL_INSTANCED))
+                    continue;
+                matrices.clear();
+                for (uint32_t cell : m_Resident) {
+                    const WorldCell &worldCell = cells[cell];
+                    auto found = std::lower_bound(worldCell.models.begin(), worldCell.models.end(), m);
+                    if (found == worldCell.models.end() || *found != m)
+                        continue;
+                    size_t k = found - worldCell.models.begin();
+                    for (uint32_t i = worldCell.firstInstance[k]; i < worldCell.firstInstance[k + 1]; i++)
+                        matrices.push_back(m_Scene.instances()[worldCell.instances[i]]);
+                }
+                InstanceLodBuckets &instances = m_Instances[m];
+                instances.create(matrices.data(), (unsigned int) matrices.size(), m_Settings.instanceAttribute,
+                                 model->LodCount(), model->boundsMin, model->boundsMax, (float) m_Models[m].atlasLayer);
+                for (const Mesh &mesh : model->meshes) {
+                    GLState::global().bindVertexArray(mesh.VAO.id());
+                    instances.setupAttributes();
+                }
+                GLState::global().bindVertexArray(0);
+            }
+        }
+    };
+};
+
+#endif //PROJECT_BASE_WORLDPARTITION_H
@@ -1,50 +1,59 @@
 #version 330 core
 out vec4 FragColor;
 
+// the material atlas: one layer per instanced model
 struct Material{
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
-    sampler2D texture_normal1;
+    sampler2DArray texture_diffuse;
+    sampler2DArray texture_specular;
+    sampler2DArray texture_normal;
     float shininess;
 };
 
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
+// the camera, once per frame for every program (see rg::FrameUniforms)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
+// the point light, shared by every program (see rg::FrameUniforms)
+layout (std140) uniform Light {
+    vec3 position;
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
-};
+    vec3 specular;
+} l;
 
 in vec2 TexCoords;
 in vec3 FragPos;
 in vec3 Normal;
+flat in float Layer;
 
-uniform vec3 viewPos;
-uniform PointLight l;
 uniform Material material;
 
 void main()
 {
+    vec3 uvw = vec3(TexCoords, Layer);
+    vec4 color = texture(material.texture_diffuse, uvw);
+
     //ambient
-    vec4 ambient = texture(material.texture_diffuse1, TexCoords) * vec4(l.ambient, 1.0f);
+    vec4 ambient = color * vec4(l.ambient, 1.0f);
 
     //diffuse
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(l.position - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec4 diffuse = texture(material.texture_diffuse1, TexCoords) * diff * vec4(l.diffuse, 1.0f);
+    vec4 diffuse = color * diff * vec4(l.diffuse, 1.0f);
 
     //specular
     vec3 viewDir = normalize(viewPos - FragPos);
     vec3 reflectionDir = reflect(-lightDir, norm);
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(norm, halfwayDir), 0.0), material.shininess);
-    vec4 specular = (texture(material.texture_specular1, TexCoords) * spec) * vec4(l.specular, 1.0f);
+    vec4 specular = (texture(material.texture_specular, uvw) * spec) * vec4(l.specular, 1.0f);
 
     //result
     float distance = length(l.position - FragPos);
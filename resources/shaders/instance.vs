@@ -1,20 +1,52 @@
 #version 330 core
+#ifdef PACKED_VERTEX
+layout (location = 0) in vec4 aPos;    // xyz relative to the mesh bounds
+layout (location = 1) in vec2 aNormal; // octahedral
+#else
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
+#endif
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in mat4 aInstanceMatrix;
+layout (location = 7) in float aLayer; // of the material atlas
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
+flat out float Layer;
 
-uniform mat4 view;
-uniform mat4 projection;
+// the camera, once per frame for every program (see rg::FrameUniforms)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+#ifdef PACKED_VERTEX
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+#endif
 
 void main()
 {
-    FragPos = vec3(aInstanceMatrix * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(aInstanceMatrix))) * aNormal;
+#ifdef PACKED_VERTEX
+    vec3 position = aPos.xyz * positionScale + positionOffset;
+    vec3 normal = octDecode(aNormal);
+#else
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+#endif
+    FragPos = vec3(aInstanceMatrix * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(aInstanceMatrix))) * normal;
     TexCoords = aTexCoords;
+    Layer = aLayer;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
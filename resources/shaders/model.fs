@@ -8,24 +8,28 @@ struct Material{
     float shininess;
 };
 
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
+// the camera, once per frame for every program (see rg::FrameUniforms)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
+// the point light, shared by every program (see rg::FrameUniforms)
+layout (std140) uniform Light {
+    vec3 position;
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
-};
+    vec3 specular;
+} l;
 
 in vec2 TexCoords;
 in vec3 FragPos;
 in vec3 Normal;
 
-uniform vec3 viewPos;
-uniform PointLight l;
 uniform Material material;
 
 void main()
@@ -8,24 +8,28 @@ struct Material{
     float shininess;
 };
 
-struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
+// the camera, once per frame for every program (see rg::FrameUniforms)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
+// the point light, shared by every program (see rg::FrameUniforms)
+layout (std140) uniform Light {
+    vec3 position;
     float constant;
+    vec3 ambient;
     float linear;
+    vec3 diffuse;
     float quadratic;
-};
+    vec3 specular;
+} l;
 
 in vec2 TexCoords;
 in vec3 FragPos;
 in mat3 TBN;
 
-uniform vec3 viewPos;
-uniform PointLight l;
 uniform Material material;
 
 void main()
@@ -34,8 +38,9 @@ void main()
     vec4 ambient = texture(material.texture_diffuse, TexCoords) * vec4(l.ambient, 1.0f);
 
     //diffuse
-    vec3 norm = texture(material.texture_normal, TexCoords).rgb;
-    norm = norm * 2.0 - 1.0;
+    // normal maps are stored as BC5 (x and y only), z is rebuilt from them
+    vec2 normXY = texture(material.texture_normal, TexCoords).rg * 2.0 - 1.0;
+    vec3 norm = vec3(normXY, sqrt(max(0.0, 1.0 - dot(normXY, normXY))));
     norm = normalize(TBN * norm);
     vec3 lightDir = normalize(l.position - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
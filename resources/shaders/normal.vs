@@ -1,9 +1,16 @@
 #version 330 core
+#ifdef PACKED_VERTEX
+layout (location = 0) in vec4 aPos;     // xyz relative to the mesh bounds, w tangent handedness
+layout (location = 1) in vec2 aNormal;  // octahedral
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec2 aTangent; // octahedral
+#else
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aTangent;
 layout (location = 4) in vec3 aBitangent;
+#endif
 //layout (location = 3) in mat4 aInstanceMatrix;
 
 out vec3 FragPos;
@@ -11,20 +18,49 @@ out vec3 Normal;
 out vec2 TexCoords;
 out mat3 TBN;
 
-uniform mat4 view;
-uniform mat4 projection;
+// the camera, once per frame for every program (see rg::FrameUniforms)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
 uniform mat4 model;
 
+#ifdef PACKED_VERTEX
+uniform vec3 positionScale;
+uniform vec3 positionOffset;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+#endif
+
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
+#ifdef PACKED_VERTEX
+    vec3 position = aPos.xyz * positionScale + positionOffset;
+    vec3 normal = octDecode(aNormal);
+    vec3 tangent = octDecode(aTangent);
+    vec3 bitangent = cross(normal, tangent) * (aPos.w * 2.0 - 1.0);
+#else
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+    vec3 tangent = aTangent;
+    vec3 bitangent = aBitangent;
+#endif
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = normal;
     TexCoords = aTexCoords;
     gl_Position = projection * view * vec4(FragPos, 1.0);
 
-    vec3 T = normalize(vec3(model * vec4(aTangent, 0.0)));
-    vec3 B = normalize(vec3(model * vec4(aBitangent, 0.0)));
-    vec3 N = normalize(vec3(model * vec4(aNormal, 0.0)));
+    vec3 T = normalize(vec3(model * vec4(tangent, 0.0)));
+    vec3 B = normalize(vec3(model * vec4(bitangent, 0.0)));
+    vec3 N = normalize(vec3(model * vec4(normal, 0.0)));
 
     TBN = mat3(T, B, N);
 }
\ No newline at end of file
@@ -1,20 +1,40 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
+#ifdef DECAL
+// one instance per decal, see rg::DecalRenderer
+layout (location = 2) in mat4 aModel;
+layout (location = 6) in vec4 aRect;   // u0 v0 u1 v1 of the texture shown
+layout (location = 7) in vec3 aNormal; // normalMatrix * (1, 1, 1), computed once on the CPU
+#endif
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoords;
 
+#ifndef DECAL
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat3 normalMatrix; // transpose(inverse(mat3(model))) of the tiles, computed once on the CPU
+#endif
+
+// the camera, once per frame for every program (see rg::FrameUniforms)
+layout (std140) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
 void main()
 {
+#ifdef DECAL
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    Normal = aNormal;
+    TexCoords = mix(aRect.xy, aRect.zw, aTexCoords);
+#else
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * vec3(1.0, 1.0, 1.0);
+    Normal = normalMatrix * vec3(1.0, 1.0, 1.0);
     TexCoords = aTexCoords;
+#endif
 
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
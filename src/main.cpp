@@ -15,6 +15,16 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <rg/LodSelection.h>
+#include <rg/ShaderManager.h>
+#include <rg/Scene.h>
+#include <rg/WorldPartition.h>
+#include <rg/MaterialAtlas.h>
+#include <rg/GroundGrid.h>
+#include <rg/DecalRenderer.h>
+#include <rg/FrameUniforms.h>
+#include <rg/GLState.h>
+#include <rg/RenderQueue.h>
 
 #include <iostream>
 
@@ -28,11 +38,9 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-unsigned int loadCubemap(std::vector<std::string> faces);
+TextureHandle loadCubemap(std::vector<std::string> faces);
 
-void configurate_instance_buffer(unsigned int num, Model model, glm::mat4 *modelMatrices, bool normal_mapping);
-
-void draw_instanced(Model model, unsigned int num);
+void submit_instanced(rg::RenderQueue &queue, Shader &shader, uint32_t material, const Model &model, const InstanceLodBuckets &instances);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -58,7 +66,7 @@ struct PointLight {
     float linear;
     float quadratic;
 };
-void setup_shader_light(Shader shader, PointLight pointLight);
+rg::LightBlock light_block(const PointLight &pointLight);
 
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
@@ -68,6 +76,12 @@ struct ProgramState {
     glm::vec3 backpackPosition = glm::vec3(0.0f);
     float backpackScale = 1.0f;
     PointLight pointLight;
+    // CPU time of the last frames (smoothed, not saved): all of it, and sorting and executing the render queue
+    float frameCpuMs = 0.0f;
+    float queueCpuMs = 0.0f;
+    size_t queuedDraws = 0;
+    // state changes of the last frame, see rg::GLState
+    rg::GLState::Counters glCalls;
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
@@ -144,6 +158,8 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    rg::loadExtensions((GLADloadproc) glfwGetProcAddress);
+    TextureLoader::global().detectCompressedFormats();
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
 //    stbi_set_flip_vertically_on_load(true);
@@ -166,198 +182,62 @@ int main() {
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-
-    // build and compile shaders
-    // -------------------------
-    Shader platoShader("resources/shaders/plato.vs", "resources/shaders/plato.fs");
-    Shader skyBoxShader("resources/shaders/sky_box.vs", "resources/shaders/sky_box.fs");
-    Shader instanceShader("resources/shaders/instance.vs", "resources/shaders/instance.fs");
-    Shader modelShader("resources/shaders/model.vs", "resources/shaders/model.fs");
-
-    // load models
-    // -----------
-    Model amanitaModel("resources/objects/amanita/amanita_a_low.obj");
-    amanitaModel.SetShaderTextureNamePrefix("material.");
-    Model ambrelaModel("resources/objects/ambrela/Big_ambrella_low.obj");
-    ambrelaModel.SetShaderTextureNamePrefix("material.");
-    Model boletusModel("resources/objects/boletus/boletus_low.obj");
-    boletusModel.SetShaderTextureNamePrefix("material.");
-    Model chantarellModel("resources/objects/chantarelle/chanterelles_low.obj");
-    chantarellModel.SetShaderTextureNamePrefix("material.");
-    Model morelModel("resources/objects/morel/morel_low.obj");
-    morelModel.SetShaderTextureNamePrefix("materal.");
-    Model russulaModel("resources/objects/russula/russula_low.obj");
-    russulaModel.SetShaderTextureNamePrefix("material.");
-    Model catModel("resources/objects/cat/12221_Cat_v1_l3.obj");
-    catModel.SetShaderTextureNamePrefix("material.");
-    Model flamingoModel("resources/objects/flamingo/19376_PinkFlamingo_V1.obj");
-    flamingoModel.SetShaderTextureNamePrefix("material.");
-    Model rabbitModel("resources/objects/rabbit/Rabbit.obj");
-    rabbitModel.SetShaderTextureNamePrefix("material.");
+    // every bind and state change from here on goes through rg::GLState, which skips the ones that change nothing
+    rg::GLState &glState = rg::GLState::global();
+    glState.depthTest(true);
+    glState.depthFunc(GL_LESS);
+    glState.cullFace(true, GL_BACK);
 
+    // load the scene and its models
+    // ------------------------------
+    // everything below reads its files out of resources.pack when there is one (see tools/pack_assets.cpp)
+    rg::AssetArchive::global().open(FileSystem::getPath("resources.pack"));
+    // placements, lights and decals come from the scene file, compiled once and mapped on later starts
+    rg::Scene scene;
+    scene.load(FileSystem::getPath("resources/scenes/wonderland.scene"));
+    // only the cells around the camera have their models and decal textures loaded, see update() in the render loop
     bool normal_mapping = false;
-    //create model matrices for amanita
-    unsigned int amanitaNum = 8;
-    glm::mat4* amanitaModelMatrises;
-    amanitaModelMatrises = new glm::mat4[amanitaNum];
-    glm::vec3 amanitaTranslations[] = {
-            glm::vec3(2.5f, 1.5f, -4.0f),
-            glm::vec3(36.5f, 1.5f, -7.5f),
-            glm::vec3(30.0f, 1.5f, -15.0f),
-            glm::vec3(33.3f, 1.5f, -19.0f),
-            glm::vec3(37.5f, 1.5f, -21.5f),
-            glm::vec3(19.5f, 1.5f, -7.6f),
-            glm::vec3(35.0f, 1.5f, -30.0f),
-            glm::vec3(19.5f, 1.5f, -32.5f),
-
-    };
-
-    for(unsigned int i = 0; i < amanitaNum; i++){
-        glm::mat4 model = glm::mat4 (1.0f);
-        model = glm::translate(model, amanitaTranslations[i]);
-        model = glm::scale(model, glm::vec3(3.2f));
-        amanitaModelMatrises[i] = model;
-    }
-    configurate_instance_buffer(amanitaNum, amanitaModel, amanitaModelMatrises, normal_mapping);
-
-    //create model matrices for amabrela
-    unsigned int ambrelaNum = 4;
-    glm::mat4* ambrelaModelMatrises;
-    ambrelaModelMatrises = new glm::mat4[ambrelaNum];
-    glm::vec3 ambrelaTranslations[] = {
-            glm::vec3(20.f, 1.5f, -10.0f),
-            glm::vec3(37.5f, 1.5f, -15.5f),
-            glm::vec3(30.0f, 1.5f, -35.0f),
-            glm::vec3(40.3f, 1.5f, -35.0f)
-    };
-
-    for(unsigned int i = 0; i < ambrelaNum; i++){
-        glm::mat4 model = glm::mat4 (1.0f);
-        model = glm::translate(model, ambrelaTranslations[i]);
-        model = glm::scale(model, glm::vec3(3.2f));
-        ambrelaModelMatrises[i] = model;
-    }
-    configurate_instance_buffer(ambrelaNum, ambrelaModel, ambrelaModelMatrises, normal_mapping);
-
-    //create model matrices for boletus
-    unsigned int boletusNum = 4;
-    glm::mat4* boletusModelMatrises;
-    boletusModelMatrises = new glm::mat4[boletusNum];
-    glm::vec3 boletusTranslations[] = {
-            glm::vec3(31.5f, 1.5f, -10.0f),
-            glm::vec3(35.5f, 1.5f, -30.0f),
-            glm::vec3(23.5f, 1.5f, -28.5f),
-            glm::vec3(25.3f, 1.5f, -35.0f)
-    };
-
-    for(unsigned int i = 0; i < boletusNum; i++){
-        glm::mat4 model = glm::mat4 (1.0f);
-        model = glm::translate(model, boletusTranslations[i]);
-        model = glm::scale(model, glm::vec3(3.2f));
-        boletusModelMatrises[i] = model;
-    }
-    configurate_instance_buffer(boletusNum, boletusModel, boletusModelMatrises, normal_mapping);
-
-    //create model matrices for chantarell
-    unsigned int chantarellNum = 5;
-    glm::mat4* chantarellModelMatrises;
-    chantarellModelMatrises = new glm::mat4[chantarellNum];
-    glm::vec3 chantarellTranslations[] = {
-            glm::vec3(42.5f, 1.5f, -20.0f),
-            glm::vec3(17.5f, 1.5f, -35.0f),
-            glm::vec3(32.5f, 1.5f, -26.5f),
-            glm::vec3(25.0f, 1.5f, -5.0f),
-            glm::vec3(27.5f, 1.5f, -40.5)
-    };
+    rg::WorldPartition world(scene, 16.0f);
+    rg::StreamingSettings streaming;
+    streaming.loadRadius = 32.0f;
+    streaming.unloadRadius = 40.0f;
+    streaming.memoryBudget = (size_t) 256 << 20;
+    streaming.instanceAttribute = normal_mapping ? 5 : 3;
+    // the mushrooms share one set of array textures, a layer per species, so they all draw with the same bindings
+    rg::MaterialAtlas materialAtlas;
+    materialAtlas.create(rg::WorldStreamer::atlasLayers(scene), 512);
+    streaming.atlas = &materialAtlas;
+    rg::WorldStreamer streamer(scene, world, streaming);
+    // the imports of the cells in reach start on the worker threads while the shaders below compile on this one
+    streamer.update(programState->camera.Position);
 
-    for(unsigned int i = 0; i < chantarellNum; i++){
-        glm::mat4 model = glm::mat4 (1.0f);
-        model = glm::translate(model, chantarellTranslations[i]);
-        model = glm::scale(model, glm::vec3(3.2f));
-        chantarellModelMatrises[i] = model;
-    }
-    configurate_instance_buffer(chantarellNum, chantarellModel, chantarellModelMatrises, normal_mapping);
-
-
-    //create model matrices for morel
-    unsigned int morelNum = 5;
-    glm::mat4* morelModelMatrises;
-    morelModelMatrises = new glm::mat4[morelNum];
-    glm::vec3 morelTranslations[] = {
-            glm::vec3(20.0f, 1.5f, -5.0f),
-            glm::vec3(42.5f, 1.5f, -17.5f),
-            glm::vec3(30.0f, 1.5f, -21.0f),
-            glm::vec3(40.0f, 1.5f, -30.0f),
-            glm::vec3(23.5f, 1.5f, -37.5)
-    };
-
-    for(unsigned int i = 0; i < morelNum; i++){
-        glm::mat4 model = glm::mat4 (1.0f);
-        model = glm::translate(model, morelTranslations[i]);
-        model = glm::scale(model, glm::vec3(3.2f));
-        morelModelMatrises[i] = model;
-    }
-    configurate_instance_buffer(morelNum, morelModel, morelModelMatrises, normal_mapping);
-
-    //create model matrices for russula
-    unsigned int russulaNum = 7;
-    glm::mat4* russulaModelMatrises;
-    russulaModelMatrises = new glm::mat4[russulaNum];
-    glm::vec3 russulaTranslations[] = {
-            glm::vec3(30.0f, 1.5f, -12.0f),
-            glm::vec3(19.5f, 1.5f, -20.5f),
-            glm::vec3(15.0f, 1.5f, -28.0f),
-            glm::vec3(17.0f, 1.5f, -30.0f),
-            glm::vec3(30.5f, 1.5f, -36.5),
-            glm::vec3(10.0f, 1.5f, -36.0f),
-            glm::vec3(13.5f, 1.5f, -37.5)
-    };
+    // build and compile shaders
+    // -------------------------
+    // only submitted here: the driver compiles them while the model uploads below run
+    ShaderManager shaderManager;
+    Shader &platoShader = shaderManager.load("resources/shaders/plato.vs", "resources/shaders/plato.fs");
+    Shader &decalShader = shaderManager.load("resources/shaders/plato.vs", "resources/shaders/plato.fs", nullptr, {"DECAL"});
+    Shader &skyBoxShader = shaderManager.load("resources/shaders/sky_box.vs", "resources/shaders/sky_box.fs");
+    Shader &instanceShader = shaderManager.load("resources/shaders/instance.vs", "resources/shaders/instance.fs", nullptr, {"PACKED_VERTEX"});
+    Shader &modelShader = shaderManager.load("resources/shaders/model.vs", "resources/shaders/model.fs");
 
-    for(unsigned int i = 0; i < russulaNum; i++){
-        glm::mat4 model = glm::mat4 (1.0f);
-        model = glm::translate(model, russulaTranslations[i]);
-        model = glm::scale(model, glm::vec3(3.2f));
-        russulaModelMatrises[i] = model;
-    }
-    configurate_instance_buffer(russulaNum, russulaModel, russulaModelMatrises, normal_mapping);
+    streamer.wait(programState->camera.Position);
+    shaderManager.poll();
 
 
     /*****/
     //vertexes
 
-    float vertices[] = {
-            // positions                 // texture coords
-            0.5f,  0.5f, 0.0f, 1.0f, 1.0f, // top right
-            0.5f, -0.5f, 0.0f,1.0f, 0.0f, // bottom right
-            -0.5f, -0.5f, 0.0f, 0.0f, 0.0f, // bottom left
-            -0.5f,  0.5f, 0.0f,   0.0f, 1.0f  // top left
-    };
-    unsigned int indices[] = {
-            0, 1, 3, // first triangle
-            1, 2, 3  // second triangle
-    };
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    // the plato: 50x50 tiles in one static mesh, one draw
+    rg::GroundGrid ground;
+    ground.create(50, 50, 1.0f);
+    // the tiles' normal matrix; the ground itself is built in world space, its model matrix is identity
+    const glm::mat3 groundNormalMatrix = glm::mat3(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)));
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // texture coord attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // the decals of the resident cells, one instanced draw per decal texture; rebuilt when those cells change
+    rg::DecalRenderer decals;
+    decals.create();
+    unsigned int decalGeneration = ~0u;
 
     float skyBoxVertices[] = {
             // positions
@@ -404,22 +284,20 @@ int main() {
             1.0f, -1.0f,  1.0f
     };
 
-    unsigned int skyBoxVBO, skyBoxVAO;
-    glGenVertexArrays(1, &skyBoxVAO);
-    glGenBuffers(1, &skyBoxVBO);
+    rg::GLVertexArray skyBoxVAO = rg::GLVertexArray::create();
+    rg::GLBuffer skyBoxVBO = rg::GLBuffer::create();
 
-    glBindVertexArray(skyBoxVAO);
+    glState.bindVertexArray(skyBoxVAO.id());
 
-    glBindBuffer(GL_ARRAY_BUFFER, skyBoxVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, skyBoxVBO.id());
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyBoxVertices), skyBoxVertices, GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3*sizeof(float ), (void*)0);
 
     //load and create textures
-    Texture2D grassDiffuse("resources/textures/grass_texture.jpg", GL_REPEAT, GL_LINEAR);
+    Texture2D grassDiffuse("resources/textures/grass_texture.jpg", GL_REPEAT, GL_LINEAR, true);
     Texture2D grassSpecular("resources/textures/grass_specular.jpg", GL_REPEAT, GL_LINEAR);
-    Texture2D bloodSplatter("resources/textures/blood-splatter-png-44474.png", GL_REPEAT, GL_CLAMP_TO_EDGE);
     vector<std::string> faces
             {
                     "resources/textures/Apocalypse/vz_apocalypse_right.png",
@@ -429,41 +307,78 @@ int main() {
                     "resources/textures/Apocalypse/vz_apocalypse_front.png",
                     "resources/textures/Apocalypse/vz_apocalypse_back.png"
             };
-    unsigned int cubemapTexture = loadCubemap(faces);
+    TextureHandle cubemapTexture = loadCubemap(faces);
 
     /*****/
 
 
     PointLight& pointLight = programState->pointLight;
-    pointLight.position = glm::vec3(4.0f, 4.0, 0.0);
-    pointLight.ambient = glm::vec3(0.2, 0.2, 0.2);
-    pointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
-    pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
+    if (scene.numLights() > 0) {
+        const rg::SceneLight &light = scene.lights()[0];
+        pointLight.position = light.position;
+        pointLight.ambient = light.ambient;
+        pointLight.diffuse = light.diffuse;
+        pointLight.specular = light.specular;
+
+        pointLight.constant = light.constant;
+        pointLight.linear = light.linear;
+        pointLight.quadratic = light.quadratic;
+    }
 
-    pointLight.constant = 1.0f;
-    pointLight.linear = 0.002f;
-    pointLight.quadratic = 0.000032f;
 
 
+    // camera and light of every program, written once per frame
+    rg::FrameUniforms frameUniforms;
+    frameUniforms.create();
+    // set for every draw, looked up once
+    Shader::Uniform modelMatrix = modelShader.uniform("model");
 
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    // render loop
-    // -----------
+    //level of detail every instance of the models drawn one by one was drawn at last frame
+    std::vector<unsigned int> instanceLods(scene.numInstances(), 0);
+
+    // what doesn't change from frame to frame: samplers, shininess, the plato's transform
+    platoShader.use();
+    platoShader.setInt("material.texture_diffuse1", 0);
+    platoShader.setInt("material.texture_specular1", 1);
+    platoShader.setFloat("material.shininess", 64.0f);
+    platoShader.setMat4("model", glm::mat4(1.0f));
+    platoShader.setMat3("normalMatrix", groundNormalMatrix);
+    decalShader.use();
+    decalShader.setInt("material.texture_diffuse1", 0);
+    decalShader.setInt("material.texture_specular1", 1);
+    decalShader.setFloat("material.shininess", 64.0f);
+    instanceShader.use();
+    instanceShader.setInt("material.texture_diffuse", 0);
+    instanceShader.setInt("material.texture_specular", 1);
+    instanceShader.setInt("material.texture_normal", 2);
     skyBoxShader.use();
     skyBoxShader.setInt("skybox", 0);
+
+    // every draw of the frame goes through it, sorted by pass, program, textures, VAO and distance
+    rg::RenderQueue renderQueue;
+
+    // render loop
+    // -----------
     while (!glfwWindowShouldClose(window)) {
         // per-frame time logic
         // --------------------
         float currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
+        double frameStart = glfwGetTime();
 
         // input
         // -----
         processInput(window);
 
+        // finish the texture uploads whose images were decoded in the meantime
+        TextureLoader::global().update();
+        // stream the world cells in and out around the camera
+        streamer.update(programState->camera.Position);
+
 
         // render
         // ------
@@ -475,114 +390,91 @@ int main() {
         pointLight.position = glm::vec3(pointLight.position);
 
         // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+        float fovY = glm::radians(programState->camera.Zoom);
+        glm::mat4 projection = glm::perspective(fovY, (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
-
-        platoShader.use();
-        platoShader.setMat4("projection", projection);
-        platoShader.setMat4("view", view);
-        platoShader.setVec3("viewPos", programState->camera.Position);
-
-        // light properties
-        setup_shader_light(platoShader, pointLight);
-        // material properties
-        platoShader.setInt("material.texture_diffuse1", 0);
-        platoShader.setInt("material.texture_specular1", 1);
-        platoShader.setFloat("material.shininess", 64.0f);
-
+        rg::FrameBlock frame;
+        frame.projection = projection;
+        frame.view = view;
+        frame.viewPos = programState->camera.Position;
+        frame.padding = 0.0f;
+        frameUniforms.update(frame, light_block(pointLight));
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        //draw plato
-        glBindVertexArray(VAO);
-        glActiveTexture(GL_TEXTURE0);
-        grassDiffuse.bind();
-        glActiveTexture(GL_TEXTURE1);
-        grassSpecular.bind();
-        for(int i = 0; i < 50; i++) {
-            for (int j = 0; j < 50; j++) {
-                glm::mat4 model = glm::mat4(1.0f);
-                model = glm::translate(model, glm::vec3(i, 1.0, -j));
-                model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-                platoShader.setMat4("model", model);
-                glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        renderQueue.begin(100.0f);
+
+        //plato
+        rg::RenderMaterial grass;
+        grass.add(GL_TEXTURE_2D, grassDiffuse.handle()->id);
+        grass.add(GL_TEXTURE_2D, grassSpecular.handle()->id);
+        ground.submit(renderQueue, platoShader, renderQueue.material(grass));
+
+        //decals (blood) of the resident cells, on top of the plato's specular map like before
+        if (decalGeneration != streamer.residentGeneration()) {
+            std::vector<uint32_t> residentDecals;
+            for (uint32_t cell : streamer.residentCells())
+                residentDecals.insert(residentDecals.end(), world.cells()[cell].decals.begin(), world.cells()[cell].decals.end());
+            decals.build(scene.decals(), residentDecals.data(), residentDecals.size());
+            decalGeneration = streamer.residentGeneration();
+        }
+        decals.submit(renderQueue, decalShader, [&](uint32_t texture) {
+            rg::RenderMaterial decal;
+            decal.add(GL_TEXTURE_2D, streamer.decalTexture(texture)->handle()->id);
+            decal.add(GL_TEXTURE_2D, grassSpecular.handle()->id);
+            return renderQueue.material(decal);
+        });
+
+        //models of the resident cells drawn one by one
+        for (uint32_t cell : streamer.residentCells()) {
+            const rg::WorldCell &worldCell = world.cells()[cell];
+            for (size_t k = 0; k < worldCell.models.size(); k++) {
+                uint32_t m = worldCell.models[k];
+                if (scene.models()[m].flags & rg::SCENE_MODEL_INSTANCED)
+                    continue;
+                const Model &drawn = *streamer.model(m);
+                for (uint32_t c = worldCell.firstInstance[k]; c < worldCell.firstInstance[k + 1]; c++) {
+                    uint32_t i = worldCell.instances[c];
+                    const glm::mat4 &model = scene.instances()[i];
+                    instanceLods[i] = rg::selectLod(rg::projectedSize(model, drawn.boundsMin, drawn.boundsMax, programState->camera.Position, fovY),
+                            instanceLods[i], drawn.LodCount());
+                    float distance = glm::length(glm::vec3(model[3]) - programState->camera.Position);
+                    drawn.Submit(renderQueue, modelShader, rg::RENDER_PASS_OPAQUE, distance, &model, modelMatrix, instanceLods[i]);
+                }
             }
         }
 
-        //draw blood
-        glActiveTexture(GL_TEXTURE0);
-        bloodSplatter.bind();
-        for(int i = 0; i < 50; i++){
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(i, 1.1, -i));
-            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-            platoShader.setMat4("model", model);
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        //levels of detail of the mushroom instances in the resident cells follow the camera
+        rg::RenderMaterial atlas;
+        for (int map = 0; map < rg::MATERIAL_MAP_COUNT; map++)
+            atlas.add(GL_TEXTURE_2D_ARRAY, materialAtlas.texture((rg::MaterialMap) map));
+        uint32_t atlasMaterial = renderQueue.material(atlas);
+        for (uint32_t m = 0; m < scene.models().size(); m++) {
+            if (!(scene.models()[m].flags & rg::SCENE_MODEL_INSTANCED) || !streamer.model(m) || streamer.instances(m).size() == 0)
+                continue;
+            streamer.instances(m).update(programState->camera.Position, fovY);
+            submit_instanced(renderQueue, instanceShader, atlasMaterial, *streamer.model(m), streamer.instances(m));
         }
 
-        modelShader.use();
-        modelShader.setMat4("view", view);
-        modelShader.setMat4("projection", projection);
-        setup_shader_light(modelShader, pointLight);
-
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(10.0, 1.0, -21.0));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
-        model = glm::scale(model, glm::vec3(0.05, 0.05, 0.05));
-        modelShader.setMat4("model", model);
-        catModel.Draw(modelShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(12.0, 1.0, -3.0));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1.0, 0.0, 0.0));
-        model = glm::scale(model, glm::vec3(0.05, 0.05, 0.05));
-        modelShader.setMat4("model", model);
-        flamingoModel.Draw(modelShader);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(10.0, 1.0, -12.0));;
-        model = glm::scale(model, glm::vec3(0.05, 0.05, 0.05));
-        modelShader.setMat4("model", model);
-        rabbitModel.Draw(modelShader);
-
-        instanceShader.use();
-        setup_shader_light(instanceShader, pointLight);
-        instanceShader.setMat4("view", view);
-        instanceShader.setMat4("projection", projection);
-        instanceShader.setInt("material.texture_diffuse", 0);
-        instanceShader.setInt("material.texture_specular", 1);
-        instanceShader.setInt("material.texture_normal", 2);
-
-        //amanita
-        draw_instanced(amanitaModel, amanitaNum);
-        //ambrela
-        draw_instanced(ambrelaModel, ambrelaNum);
-        //boletus
-        draw_instanced(boletusModel, boletusNum);
-        //chantarell
-        draw_instanced(chantarellModel, chantarellNum);
-        //morel
-        draw_instanced(morelModel, morelNum);
-        //russula
-        draw_instanced(russulaModel, russulaNum);
-
-
-        //draw sky box
-        glDepthFunc(GL_LEQUAL);
-        skyBoxShader.use();
-        view = glm::mat4(glm::mat3(view)); //removing the translation part
-        skyBoxShader.setMat4("view", view);
-        skyBoxShader.setMat4("projection", projection);
-
-        glBindVertexArray(skyBoxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
-
-        if (programState->ImGuiEnabled)
+        //sky box, sky_box.vs drops the translation of the view itself
+        rg::RenderMaterial sky;
+        sky.add(GL_TEXTURE_CUBE_MAP, cubemapTexture->id);
+        renderQueue.submit(rg::RENDER_PASS_SKY, 0.0f,
+                           rg::DrawPacket::arrays(skyBoxShader, renderQueue.material(sky), skyBoxVAO.id(), 0, 36));
+
+        double queueStart = glfwGetTime();
+        renderQueue.execute();
+        programState->queueCpuMs += ((glfwGetTime() - queueStart) * 1000.0 - programState->queueCpuMs) * 0.05f;
+        programState->queuedDraws = renderQueue.size();
+
+        programState->frameCpuMs += ((glfwGetTime() - frameStart) * 1000.0 - programState->frameCpuMs) * 0.05f;
+
+        glState.endFrame();
+        programState->glCalls = glState.lastFrame();
+        if (programState->ImGuiEnabled) {
             DrawImGui(programState);
+            // the ImGui renderer sets its own state
+            glState.invalidate();
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -597,11 +489,15 @@ int main() {
     ImGui::DestroyContext();
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteVertexArrays(1, &skyBoxVAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &skyBoxVAO);
-
+    ground.reset();
+    decals.reset();
+    frameUniforms.reset();
+    skyBoxVAO.reset();
+    skyBoxVBO.reset();
+
+    // the streamed models and instance buffers go out of scope after glfwTerminate, they only forget their ids
+    rg::shutdownGLObjects();
+    TextureRegistry::global().shutdown();
     glfwTerminate();
     return 0;
 }
@@ -688,6 +584,26 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        ImGui::Begin("Frame");
+        ImGui::Text("CPU frame (without ImGui and swap): %.3f ms", programState->frameCpuMs);
+        ImGui::Text("CPU render queue (sort and execute): %.3f ms, %zu draws", programState->queueCpuMs, programState->queuedDraws);
+        ImGui::Text("State changes: %u issued, %u filtered", programState->glCalls.issued, programState->glCalls.filtered);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Textures");
+        size_t total = 0;
+        for (const TextureRegistry::EntryInfo& entry : TextureRegistry::global().entries()) {
+            ImGui::Text("%8.2f MB  %4dx%-4d  refs %ld%s  %s", entry.gpuBytes / (1024.0 * 1024.0), entry.width, entry.height,
+                        entry.references, entry.alias ? "  alias" : "", entry.path.c_str());
+            total += entry.gpuBytes;
+        }
+        ImGui::Text("Total: %.2f MB", total / (1024.0 * 1024.0));
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -704,104 +620,52 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     }
 }
 
-unsigned int loadCubemap(vector<std::string> faces){
-    unsigned int t_id;
-    glGenTextures(1, &t_id);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, t_id);
-
-    //load images
-    int width, height, nChannels;
-    for(unsigned int i = 0; i < faces.size(); i++){
-        unsigned char *data = stbi_load(FileSystem::getPath(faces[i]).c_str(),
-                                        &width, &height, &nChannels, 0);
-        if(data){
-            std::cout << "Tekstura za sky box je ucitana\n";
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0 , GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        }else{
-            ASSERT(false, "Tekstura za sky box nije mogla da se ucita");
-        }
-        stbi_image_free(data);
-
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    }
-    return t_id;
+TextureHandle loadCubemap(vector<std::string> faces){
+    // the six faces are decoded in parallel and uploaded as they come in
+    for(unsigned int i = 0; i < faces.size(); i++)
+        faces[i] = FileSystem::getPath(faces[i]);
+    return TextureLoader::global().loadCubemap(faces);
 }
 
-void configurate_instance_buffer(unsigned int num, Model model, glm::mat4 *modelMatrices, bool normal_mapping){
-    //configurate instance array
-    unsigned int buffer;
-    glGenBuffers(1, &buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    glBufferData(GL_ARRAY_BUFFER, num*sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
+void submit_instanced(rg::RenderQueue &queue, Shader &shader, uint32_t material, const Model &model, const InstanceLodBuckets &instances){
+    //the material is the atlas, each instance carries its layer
     for (unsigned int i = 0; i < model.meshes.size(); i++)
     {
-        unsigned int VAO = model.meshes[i].VAO;
-        glBindVertexArray(VAO);
-        // set attribute pointers for matrix (4 times vec4)
-        if(normal_mapping == false) {
-            glEnableVertexAttribArray(3);
-            glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *) 0);
-            glEnableVertexAttribArray(4);
-            glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *) (sizeof(glm::vec4)));
-            glEnableVertexAttribArray(5);
-            glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *) (2 * sizeof(glm::vec4)));
-            glEnableVertexAttribArray(6);
-            glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void *) (3 * sizeof(glm::vec4)));
-
-            glVertexAttribDivisor(3, 1);
-            glVertexAttribDivisor(4, 1);
-            glVertexAttribDivisor(5, 1);
-            glVertexAttribDivisor(6, 1);
-        }else{
-            glEnableVertexAttribArray(5);
-            glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-            glEnableVertexAttribArray(6);
-            glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-            glEnableVertexAttribArray(7);
-            glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-            glEnableVertexAttribArray(8);
-            glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
-
-            glVertexAttribDivisor(5, 1);
-            glVertexAttribDivisor(6, 1);
-            glVertexAttribDivisor(7, 1);
-            glVertexAttribDivisor(8, 1);
+        const Mesh &mesh = model.meshes[i];
+        //one draw per level, instances past the mesh's coarsest level draw that one
+        unsigned int lastLod = mesh.LodCount() - 1;
+        for (unsigned int lod = 0; lod <= lastLod; lod++)
+        {
+            unsigned int count = instances.count(lod, lastLod);
+            if (count == 0)
+                continue;
+            rg::DrawPacket packet = rg::DrawPacket::elements(shader, material, mesh.VAO.id(), mesh.Lod(lod).indexCount,
+                                                             mesh.indexType, mesh.LodIndexOffset(lod));
+            packet.instances = count;
+            packet.prepare = [](Shader &shader, const void *mesh, const void *instances, unsigned int first) {
+                ((const Mesh *) mesh)->SetVertexDecodeUniforms(shader);
+                ((const InstanceLodBuckets *) instances)->pointAttributes(first);
+            };
+            packet.object = &mesh;
+            packet.data = &instances;
+            packet.argument = instances.first(lod);
+            //the levels are distance bands, the nearer ones sort first
+            queue.submit(rg::RENDER_PASS_OPAQUE, (float) lod, packet);
         }
-
-        glBindVertexArray(0);
-    }
-}
-
-void draw_instanced(Model model, unsigned int num){
-    //bind textures
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, model.textures_loaded[0].id);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, model.textures_loaded[1].id);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, model.textures_loaded[2].id);
-    for (unsigned int i = 0; i < model.meshes.size(); i++)
-    {
-        glBindVertexArray(model.meshes[i].VAO);
-        glDrawElementsInstanced(GL_TRIANGLES, model.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, num);
-        glBindVertexArray(0);
     }
 }
 
-void setup_shader_light(Shader shader, PointLight pointLight){
-    shader.setVec3("l.position", pointLight.position);
-    shader.setVec3("l.ambient", pointLight.ambient);
-    shader.setVec3("l.diffuse", pointLight.diffuse);
-    shader.setVec3("l.specular", pointLight.specular);
-    shader.setFloat("l.constant", pointLight.constant);
-    shader.setFloat("l.linear", pointLight.linear);
-    shader.setFloat("l.quadratic", pointLight.quadratic);
+rg::LightBlock light_block(const PointLight &pointLight){
+    rg::LightBlock light;
+    light.position = pointLight.position;
+    light.ambient = pointLight.ambient;
+    light.diffuse = pointLight.diffuse;
+    light.specular = pointLight.specular;
+    light.constant = pointLight.constant;
+    light.linear = pointLight.linear;
+    light.quadratic = pointLight.quadratic;
+    light.padding = 0.0f;
+    return light;
 }
 
 
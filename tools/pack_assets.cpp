@@ -0,0 +1,49 @@
+// Packs resources/ into resources.pack (rg/AssetArchive.h), which the program maps at start instead of opening
+// the files one by one. Run from the source directory after changing any asset: ./pack_assets
+// resources/cache (rebuilt per machine) and resources/program_state.txt (written at exit) stay loose.
+
+#include <learnopengl/filesystem.h>
+#include <rg/AssetArchive.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+void collect(const std::string &root, const std::string &directory, std::vector<std::string> &files) {
+    DIR *dir = opendir((root + "/" + directory).c_str());
+    if (!dir)
+        return;
+    while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string path = directory + "/" + name;
+        if (path == "resources/cache" || path == "resources/program_state.txt")
+            continue;
+        struct stat st;
+        if (stat((root + "/" + path).c_str(), &st) != 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            collect(root, path, files);
+        else if (S_ISREG(st.st_mode))
+            files.push_back(path);
+    }
+    closedir(dir);
+}
+
+int main() {
+    std::string root = FileSystem::getPath("");
+    root = root.empty() ? "." : root.substr(0, root.size() - 1);
+    std::vector<std::string> files;
+    collect(root, "resources", files);
+    std::string archive = root + "/resources.pack";
+    if (!rg::AssetArchive::write(archive, root, files)) {
+        std::cout << "ERROR::PACK_ASSETS:: could not write " << archive << std::endl;
+        return 1;
+    }
+    std::cout << "packed " << files.size() << " files into " << archive << std::endl;
+    return 0;
+}